@@ -0,0 +1,71 @@
+/*
+ * Checks the per-stream accounting of the verification mode. tsctp.c is
+ * included to reach its static functions, its main is renamed.
+ */
+#define main tsctp_main
+#include "tsctp.c"
+#undef main
+
+static int failures;
+
+static void expect(const char *what, unsigned long long value, unsigned long long wanted)
+{
+	if (value != wanted) {
+		printf("%s: %llu, expected %llu\n", what, value, wanted);
+		failures++;
+	}
+}
+
+/* Sequence numbers wrap after 2^32 messages on a stream. */
+static void check_wrap(void)
+{
+	struct stream_stats s;
+
+	memset(&s, 0, sizeof(s));
+	s.next_seq = 0xfffffffe;
+	s.expected = 0xfffffffeULL;
+	s.received = 0xfffffffeULL;
+	stream_account(&s, 0xfffffffe);
+	stream_account(&s, 0xffffffff);
+	stream_account(&s, 0);
+	stream_account(&s, 1);
+	expect("wrap: received", s.received, 0x100000002ULL);
+	expect("wrap: missing", stream_missing(&s), 0);
+	stream_account(&s, 3);
+	expect("wrap: missing after a gap", stream_missing(&s), 1);
+	stream_account(&s, 2);
+	expect("wrap: missing after reordering", stream_missing(&s), 0);
+	expect("wrap: out of order", s.out_of_order, 1);
+}
+
+/* A duplicate arriving after it left the reorder window. */
+static void check_too_old(void)
+{
+	struct stream_stats s;
+	uint32_t seq;
+
+	memset(&s, 0, sizeof(s));
+	for (seq = 0; seq < REORDER_WINDOW + 10; seq++) {
+		stream_account(&s, seq);
+	}
+	stream_account(&s, 0);
+	expect("too old: received", s.received, REORDER_WINDOW + 10);
+	expect("too old: too old", s.too_old, 1);
+	expect("too old: duplicates", s.duplicates, 0);
+	expect("too old: out of order", s.out_of_order, 0);
+	expect("too old: missing", stream_missing(&s), 0);
+	stream_account(&s, REORDER_WINDOW + 5);
+	expect("too old: duplicates in the window", s.duplicates, 1);
+	expect("too old: missing after a duplicate", stream_missing(&s), 0);
+}
+
+int main(void)
+{
+	check_wrap();
+	check_too_old();
+	if (failures > 0) {
+		return 1;
+	}
+	printf("Stream accounting checks passed.\n");
+	return 0;
+}
@@ -25,22 +25,54 @@
  *
  */
 
+#ifdef LINUX
+#define _GNU_SOURCE
+#endif
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#if defined(USRSCTP)
+#include <usrsctp.h>
+#else
 #include <netinet/sctp.h>
+#endif
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#if defined(__FreeBSD__)
+#include <pthread_np.h>
+#endif
 #include <signal.h>
 #ifdef LINUX
 #include <getopt.h>
 #endif
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(USRSCTP)
+/* Sockets of the userland stack can't be polled or handed to sendmmsg()/recvmmsg(). */
+#undef HAVE_SYS_EPOLL_H
+#undef HAVE_SENDMMSG
+#undef HAVE_RECVMMSG
+#endif
+#if defined(HAVE_SYS_EPOLL_H)
+#include <sys/epoll.h>
+#endif
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 
 #ifndef timersub
 #define timersub(tvp, uvp, vvp)                                         \
@@ -54,252 +86,6221 @@
         } while (0)
 #endif
 
+#ifndef timeradd
+#define timeradd(tvp, uvp, vvp)                                         \
+        do {                                                            \
+                (vvp)->tv_sec = (tvp)->tv_sec + (uvp)->tv_sec;          \
+                (vvp)->tv_usec = (tvp)->tv_usec + (uvp)->tv_usec;       \
+                if ((vvp)->tv_usec >= 1000000) {                        \
+                        (vvp)->tv_sec++;                                \
+                        (vvp)->tv_usec -= 1000000;                      \
+                }                                                       \
+        } while (0)
+#endif
+
 
-char Usage[] =
-"Usage: tsctp [options] [address]\n"
-"Options:\n"
-"        -a      set adaptation layer indication\n"
-"        -A      chunk type to authenticate \n"
-"        -d      time in seconds after which a status update is printed\n"
-"        -D      turns Nagle off\n"
-"        -f      fragmentation point\n"
+static const char *usage[] = {
+	"Usage: tsctp [options] [address ...]\n",
+	"Options:\n",
+	"        -a      set adaptation layer indication\n",
+	"        -A      chunk type to authenticate, or one of hmac=sha1|sha256 (the HMAC the peer should use),\n",
+	"                key=hex (the shared key, numbered 1, keys 2 to 4 append their number to it) and\n",
+	"                rotate=seconds (the client changes the active key this often); without chunk types,\n",
+	"                DATA chunks are authenticated\n",
+#if defined(HAVE_SENDMMSG)
+	"        -b      number of messages per sendmmsg/recvmmsg call (default 32)\n",
+#endif
+	"        -B      size of the receive buffer (0 means adaptive, default 65536)\n",
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+	"        -c      comma separated list of CPUs to pin the sender threads or receive workers to\n",
+#endif
+	"        -C      measure the association setup rate: each thread sets up this many associations (0 means until\n",
+	"                the time given by -T), sends the number of messages given by -n (default 0) and closes them\n",
+	"        -d      time in seconds after which a status update is printed; the server also prints the\n",
+	"                throughput over all associations and, if given after a comma, the busiest associations\n",
+	"        -D      turns Nagle off\n",
+#if defined(SCTP_SNDINFO) && !defined(USRSCTP)
+	"        -e      send/receive engine (0=sctp_sendmsg/sctp_recvmsg (default), 1=sendmsg/recvmsg with SCTP_SNDINFO/SCTP_RCVINFO"
+#if defined(HAVE_SENDMMSG)
+	", 2=sendmmsg/recvmmsg"
+#endif
+	")\n",
+#endif
+	"        -E      embed send timestamps and report the one-way latency (both ends must share the clock)\n",
+	"        -f      fragmentation point\n",
+	"        -F      duplex mode, both sides send and receive at the same time on each association\n",
+	"                (the server sends until the client shuts down, unless -n is given)\n",
+	"        -g      pace the sender to this many bit/sec (k, M and G suffixes allowed)\n",
+	"        -G      pace the sender to this many messages/sec (k, M and G suffixes allowed)\n",
+	"        -h      coalesce messages into user messages of up to this many bytes, each message is prefixed\n",
+	"                by its length; optionally followed by a comma and the time in microseconds a message may\n",
+	"                wait before it is sent (default no limit). The receiver unpacks user messages with the\n",
+	"                PPID of coalesced ones, which it doesn't see with -X\n",
+	"        -H      like -C, but keep up to this many associations open over all threads, for the time given\n",
+	"                by -T, and report the memory used per association\n",
+	"        -i      stamp messages with a sequence number, timestamp and checksum and verify them when received\n",
 #if defined(SCTP_INTERLEAVING_SUPPORTED)
-"        -I      Interleaving\n"
-#endif
-"        -l      size of send/receive buffer\n"
-"        -L      local address\n"
-"        -n      number of messages sent (0 means infinite)/received\n"
-"        -p      port number\n"
-"        -P      partial reliability policy to use (0=none (default), 1=ttl, 2=rtx, 3=buf)\n"
-"        -R      socket recv buffer\n"
-"        -s      number of streams\n"
-"        -S      socket send buffer\n"
-"        -t      based on -P the time to live, number of retransmissions, or priority for messages\n"
-"        -T      time to send messages\n"
-"        -u      use unordered user messages\n"
+	"        -I      Interleaving\n",
+#endif
+	"        -j      comma separated list of stream weights, messages are spread over the streams in proportion\n",
+	"                (streams not listed get weight 1)\n",
+	"        -J      message sizes: fixed (the length given by -l, default), uniform:min-max, exp:mean[,max]\n",
+	"                (max defaults to 16 times the mean) or bimodal:small,large,fraction (of large messages)\n",
+	"        -k      number of messages sent back to back when pacing (default 1)\n",
+	"        -K      keep the associations open between the points of a sweep\n",
+	"        -l      message length (k, M and G suffixes allowed, in powers of 1024), optionally followed by a\n",
+	"                colon and a piece size: the sender hands each message to the stack in pieces of this size\n",
+	"                using explicit EOR, the server uses it as partial delivery point and reports how messages\n",
+	"                were delivered\n",
+	"        -L      local address\n",
+	"        -m      use one-to-many style sockets (SOCK_SEQPACKET)\n",
+#if defined(USRSCTP)
+	"        -M      run the server in this process and exchange packets with it over a memory conduit (memory)\n",
+	"                or UDP encapsulation on the port given by -U (udp, default 9899)\n",
+#endif
+	"        -n      number of messages sent (0 means infinite)/received per association\n",
+	"        -N      number of associations, each driven by its own thread\n",
+	"                (with -m: number of threads sending on the one-to-many socket)\n",
+	"        -o      number of outstanding requests in request/response mode (default 1)\n",
+	"        -O      output format (text (default), csv or json)\n",
+	"        -p      port number\n",
+	"        -P      partial reliability policy to use (0=none (default), 1=ttl, 2=rtx, 3=buf or prio on Linux),\n",
+	"                the sender reports the messages abandoned\n",
+	"        -Q      report the CPU time and, where permitted, the cycles, instructions, cache misses, context\n",
+	"                switches and system calls of each sending and receiving thread; receive workers (-w) and\n",
+	"                the one-to-many receiver (-m) report theirs whenever they have no association left\n",
+	"        -q      backlog of the listening socket (default 100)\n",
+	"        -r      request/response mode, the receiver answers each message with a response of this length\n",
+	"        -R      socket recv buffer\n",
+	"        -s      number of streams\n",
+	"        -S      socket send buffer\n",
+	"        -t      based on -P the time to live, number of retransmissions, or priority for messages\n",
+	"        -T      time to send messages\n",
+	"        -u      use unordered user messages\n",
 #if defined(SCTP_REMOTE_UDP_ENCAPS_PORT)
-"        -U      use UDP encapsulation with given port\n"
+	"        -U      use UDP encapsulation with given port\n",
+#endif
+	"        -v      verbose\n",
+	"        -V      very verbose\n",
+#if defined(HAVE_SYS_EPOLL_H)
+	"        -w      number of event driven receive workers (0 means one per CPU)\n",
+#endif
+	"        -W      sweep a parameter, given as name=list with name one of length, streams, sndbuf, nodelay,\n",
+	"                policy (as -P), prvalue (as -t) or coalesce (as -h)\n",
+	"                and list a comma separated list of values or ranges first-last[:step] or first-last*factor\n",
+	"        -x      sample transport statistics with every status update and write them to this file (- for none)\n",
+	"        -X      don't ask for ancillary data on received messages unless needed\n",
+#if defined(SCTP_STREAM_SCHEDULER)
+	"        -y      stream scheduler (default, fcfs, prio, rr, rrp, fc, fb or wfq, as far as the stack has it),\n",
+	"                optionally followed by a colon and a comma separated list of per-stream values\n",
+	"                (priorities for prio, weights for wfq)\n",
 #endif
-"        -v      verbose\n"
-"        -V      very verbose\n"
-"        -4      IPv4 only\n"
-"        -6      IPv6 only\n"
-;
+	"        -Y      warm-up time in seconds, messages sent meanwhile are not counted\n",
+	"        -z      report throughput, messages and latency per stream\n",
+	"        -Z      replay a trace file, each line gives the send time in seconds, size and stream of a message\n",
+	"                (modulo -s); the trace is repeated with -T, otherwise -n defaults to its number of messages\n",
+	"        -4      IPv4 only\n",
+	"        -6      IPv6 only\n",
+	NULL
+};
+
+static void print_usage(void)
+{
+	const char **line;
+
+	for (line = usage; *line != NULL; line++) {
+		fprintf(stderr, "%s", *line);
+	}
+}
 
 #define DEFAULT_LENGTH             1024
 #define DEFAULT_NUMBER_OF_MESSAGES 1024
 #define DEFAULT_PORT               5001
 #define BUFFERSIZE                  (1<<16)
+#define MAX_RECV_BUFFERSIZE         (1<<26)
 #define LINGERTIME                 1
 #define MAX_LOCAL_ADDR             10
+#define OUTPUT_TEXT                0
+#define OUTPUT_CSV                 1
+#define OUTPUT_JSON                2
+#define MAX_CPUS                   256
+#define MAX_EVENTS                 64
+#define MAX_READS_PER_EVENT        16
+#define MAX_REMOTE_ADDR            64
+#define MAX_PATHS                  8
+#define DEFAULT_BATCH_SIZE         32
+#define HISTOGRAM_SUB_BITS         4
+#define HISTOGRAM_SUB_BUCKETS      (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS          ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+#define ASSOC_TABLE_SIZE           1024
+#define MAX_SWEEP_VALUES           1024
+#define PAYLOAD_MAGIC              0x74736370
+#define PAYLOAD_FLAG_PR            0x0001
+#define PAYLOAD_HEADER_SIZE        ((int)sizeof(struct payload_header))
+#define REORDER_WINDOW             1024
+#define CHECKSUM_LANES             32
+#define CHECKSUM_MODULUS           65521
+#define CHECKSUM_REDUCE            2048
+#define SWEEP_NODELAY              0
+#define SWEEP_SNDBUF               1
+#define SWEEP_STREAMS              2
+#define SWEEP_LENGTH               3
+#define SWEEP_POLICY               4
+#define SWEEP_PRVALUE              5
+#define SWEEP_COALESCE             6
+#define NUMBER_OF_SWEEP_PARAMETERS 7
+#define LOOPBACK_NONE              0
+#define LOOPBACK_MEMORY            1
+#define LOOPBACK_UDP               2
+#define MAX_SOCKETS                1024
+#define DEFAULT_BACKLOG            100
+#define COST_CYCLES                0
+#define COST_INSTRUCTIONS          1
+#define COST_CACHE_MISSES          2
+#define COST_CONTEXT_SWITCHES      3
+#define COST_SYSCALLS              4
+#define NUMBER_OF_COST_COUNTERS    5
+#define SIZE_FIXED                 0
+#define SIZE_UNIFORM               1
+#define SIZE_EXPONENTIAL           2
+#define SIZE_BIMODAL               3
+#define SIZE_TRACE                 4
+#define COALESCE_MAGIC             0x74736362
+#define COALESCE_HEADER_SIZE       4
+#define COALESCE_PPID              0x74736362
+#define MAX_VARINT_SIZE            5
+#define MAX_AUTH_KEY_LENGTH        256
+#define NUMBER_OF_AUTH_KEYS        4
+#define CACHE_LINE_SIZE            64
+#define MAX_CONNECTION_SLOTS       4096
+
+union sock_union {
+	struct sockaddr sa;
+	struct sockaddr_in s4;
+	struct sockaddr_in6 s6;
+#if defined(USRSCTP)
+	struct sockaddr_conn sconn;
+#endif
+};
+
+struct histogram {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/* Prepended to each message in verification mode, in network byte order. */
+struct payload_header {
+	uint32_t magic;
+	uint16_t sid;
+	uint16_t flags;
+	uint32_t seq;
+	uint32_t checksum;
+	uint32_t time_high;
+	uint32_t time_low;
+};
+
+struct checksum {
+	uint32_t a[CHECKSUM_LANES];
+	uint32_t b[CHECKSUM_LANES];
+	unsigned int blocks;
+	unsigned int pending;
+	uint64_t length;
+	unsigned char tail[CHECKSUM_LANES];
+};
+
+/*
+ * Sequence numbers in [next_seq - REORDER_WINDOW, next_seq) are tracked in
+ * window. expected extends next_seq beyond 32 bits, it is the number of
+ * messages sent up to the highest one received. Messages arriving after
+ * they left the window can't be told from duplicates and are only counted
+ * as too old.
+ */
+struct stream_stats {
+	uint32_t next_seq;
+	int pr;
+	unsigned long long expected;
+	unsigned long long received;
+	unsigned long too_old;
+	unsigned long duplicates;
+	unsigned long out_of_order;
+	unsigned long corrupted;
+	unsigned long max_reorder;
+	unsigned long long total_reorder;
+	uint64_t window[REORDER_WINDOW / 64];
+};
+
+struct verifier {
+	char header[sizeof(struct payload_header)];
+	unsigned int header_bytes;
+	struct checksum checksum;
+	unsigned long invalid;
+	unsigned int max_streams;
+	unsigned int nr_streams;
+	struct stream_stats *streams;
+	struct histogram latency;
+	struct histogram round_latency;
+};
+
+struct stream_counters {
+	unsigned long long bytes;
+	unsigned long messages;
+	struct histogram latency;
+};
+
+struct record {
+	const char *side;
+	const char *type;
+	long long assoc_id;
+	unsigned long long bytes;
+	unsigned long messages;
+	unsigned long recv_calls;
+	unsigned long notifications;
+	double seconds;
+	const struct histogram *latency;
+	int has_stream;
+	unsigned int stream;
+	const struct stream_stats *verification;
+	int has_setup;
+	unsigned long failures;
+	double process_memory;
+	double system_memory;
+	const struct cpu_cost *cost;
+	double enqueued_seconds;
+	const struct pr_status *abandoned;
+	unsigned long user_messages;
+	double peak_memory;
+	int has_auth;
+	int auth_data;
+	int has_associations;
+	unsigned int associations;
+};
+
+struct path_sample {
+	char address[INET6_ADDRSTRLEN];
+	int32_t state;
+	uint32_t cwnd;
+	uint32_t srtt;
+	uint32_t rto;
+	uint32_t mtu;
+};
+
+struct transport_sample {
+	struct timeval time;
+	int valid;
+	int32_t state;
+	uint32_t rwnd;
+	uint32_t unacked;
+	uint32_t pending;
+	int have_stats;
+	uint64_t rtx_chunks;
+	uint64_t gap_acks;
+	uint64_t out_of_seq_tsns;
+	uint64_t isacks;
+	uint64_t osacks;
+	uint64_t max_rto;
+	unsigned int nr_paths;
+	struct path_sample paths[MAX_PATHS];
+};
+
+/*
+ * Counters of a connection for the server-wide status updates. They are
+ * written only by the thread receiving on the connection and read by the
+ * reporter, so plain stores suffice. Each slot fills a cache line of its
+ * own, the receiving threads don't share lines.
+ */
+struct slot_counters {
+	volatile unsigned long long bytes;
+	volatile unsigned long messages;
+	long long assoc_id;
+	unsigned long generation;
+	int used;
+};
+
+union connection_slot {
+	struct slot_counters c;
+	char line[CACHE_LINE_SIZE];
+};
+
+struct connection {
+	int fd;
+	sctp_assoc_t assoc_id;
+	struct connection *next;
+	unsigned long long sum;
+	unsigned long messages;
+	unsigned long recv_calls;
+	unsigned long notifications;
+	unsigned int first_length;
+	struct timeval start_time;
+	unsigned long long round_sum;
+	unsigned long round_messages;
+	unsigned long round_recv_calls;
+	unsigned long round_notifications;
+	struct timeval round_start;
+	unsigned long round;
+	int in_message;
+	char request_head[sizeof(uint64_t)];
+	char *response;
+	struct verifier *verifier;
+	unsigned int nr_streams;
+	struct stream_counters *streams;
+	struct cpu_cost *cost;
+	int coalesced;
+	unsigned int frame_skip;
+	uint32_t frame_length;
+	unsigned int frame_shift;
+	uint32_t frame_remaining;
+	unsigned long user_messages;
+	uint64_t message_start;
+	unsigned long partial_reads;
+	struct histogram *delivery;
+	union connection_slot *slot;
+	int cost_counted;
+};
+
+#if defined(HAVE_SYS_EPOLL_H)
+struct receive_worker {
+	unsigned int index;
+	int epfd;
+	int cpu;
+	pthread_t tid;
+};
+#endif
+
+#if defined(SCTP_SNDINFO)
+struct send_batch {
+	unsigned int size;
+	struct iovec iov;
+	struct iovec *iovs;
+	char *headers;
+	int *lengths;
+#if defined(HAVE_SENDMMSG)
+	struct mmsghdr *msgs;
+#else
+	struct msghdr *msgs;
+#endif
+	char *control;
+	struct sctp_sndinfo **sndinfo;
+};
+#endif
+
+struct recv_result {
+	char *buf;
+	ssize_t n;
+	int flags;
+	struct sctp_sndrcvinfo sinfo;
+};
+
+struct receiver {
+	unsigned int slots;
+	size_t buffer_size;
+	char *buffers;
+	struct recv_result *results;
+	int eof;
+	int grow;
+#if defined(SCTP_RCVINFO)
+	struct iovec *iovs;
+	char *control;
+	size_t control_len;
+#if defined(HAVE_RECVMMSG)
+	struct mmsghdr *msgs;
+#else
+	struct msghdr *msgs;
+#endif
+#endif
+};
+
+struct pacer {
+	uint64_t interval;
+	uint64_t next;
+	unsigned long late;
+	uint64_t total_lag;
+	uint64_t max_lag;
+};
+
+/* The last parameter varies fastest. */
+struct sweep_parameter {
+	const char *name;
+	unsigned int nr_values;
+	long *values;
+};
+
+/*
+ * CPU used by a thread while sending or receiving, and the work it did
+ * meanwhile. Counters which could not be opened are marked as missing.
+ */
+struct cpu_cost {
+	struct timeval user;
+	struct timeval system;
+	uint64_t counters[NUMBER_OF_COST_COUNTERS];
+	int fds[NUMBER_OF_COST_COUNTERS];
+	unsigned int missing;
+	int user_only;
+	long context_switches;
+	unsigned long long bytes;
+	unsigned long messages;
+	unsigned long calls;
+};
+
+/*
+ * CPU used by a thread receiving on several associations, from the first
+ * association it serves until none is left.
+ */
+struct thread_cost {
+	struct cpu_cost cost;
+	struct timeval start_time;
+	unsigned int active;
+	unsigned long associations;
+	unsigned long long bytes;
+	unsigned long messages;
+	unsigned long calls;
+};
+
+/* Messages abandoned by PR-SCTP, as counted by the sending stack. */
+struct pr_status {
+	uint64_t unsent;
+	uint64_t sent;
+};
+
+struct sender_info {
+	unsigned int index;
+	int cpu;
+	int fd;
+	pthread_t tid;
+	unsigned long messages;
+	struct timeval start_time;
+	struct timeval stop_time;
+	struct timeval enqueued_time;
+	int acknowledged;
+	struct histogram rtt;
+	struct pacer pacer;
+	uint32_t *seqs;
+	uint32_t body_checksum;
+	long *stream_credit;
+	volatile int stop;
+	unsigned long setup_limit;
+	unsigned long associations;
+	unsigned long failures;
+	struct histogram setup;
+	int *held;
+	unsigned long nr_held;
+	unsigned long calls;
+	struct cpu_cost cost;
+	unsigned long long bytes;
+	uint64_t random;
+	size_t trace_offset;
+	uint64_t trace_start;
+	double trace_base;
+	int has_pr_status;
+	struct pr_status abandoned;
+	struct pr_status *stream_abandoned;
+	unsigned long user_messages;
+	struct histogram delay;
+	struct histogram completion;
+	int has_auth;
+	int auth_data;
+};
+
+/* Messages of one stream collected to be sent as one user message. */
+struct coalesce_buffer {
+	char *data;
+	size_t fill;
+	unsigned int count;
+	unsigned long long bytes;
+	uint64_t *times;
+	uint64_t deadline;
+};
 
 static int verbose, very_verbose;
-static unsigned int done;
+static int output_format;
+static int sample_transport_stats;
+static FILE *transport_file;
+static volatile unsigned int done;
 static unsigned int round_duration;
+static volatile unsigned long report_round;
+static unsigned int top_associations;
+static union connection_slot *slots;
+static pthread_mutex_t slots_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long long closed_bytes;
+static unsigned long closed_messages;
+static unsigned long untracked;
 
-void stop_sender(int sig)
+static const int on = 1;
+static const int off = 0;
+static int ipv4only, ipv6only;
+static struct sockaddr_storage local_addr[MAX_LOCAL_ADDR];
+static unsigned int nr_local_addr;
+static union sock_union remote_addrs[MAX_REMOTE_ADDR];
+static socklen_t remote_addr_lens[MAX_REMOTE_ADDR];
+static unsigned int nr_remote_addr;
+static int one_to_many;
+static int one_to_many_fd;
+static sctp_assoc_t assoc_ids[MAX_REMOTE_ADDR];
+static struct connection *assoc_table[ASSOC_TABLE_SIZE];
+static uint16_t streams;
+static int length;
+static unsigned long number_of_messages;
+static int nodelay;
+static int rcvbufsize, sndbufsize;
+static int fragpoint;
+static unsigned int timetolive;
+static uint32_t send_flags;
+static uint16_t pr_policy;
+static int engine;
+static unsigned int batch_size;
+static size_t recv_buffer_size;
+static double message_rate;
+static unsigned int burst;
+static int no_ancillary;
+static int want_rcvinfo;
+static int response_length;
+static unsigned int outstanding;
+static struct sctp_setadaptation ind;
+#ifdef SCTP_AUTH_CHUNK
+static unsigned int number_of_chunks_to_auth;
+static unsigned char chunk[256];
+static uint16_t hmac_ident;
+static unsigned char auth_key[MAX_AUTH_KEY_LENGTH];
+static unsigned int auth_key_length;
+#endif
+static unsigned int auth_rotate;
+static unsigned long key_changes;
+#ifdef SCTP_REMOTE_UDP_ENCAPS_PORT
+static uint16_t udp_port;
+#endif
+#if defined(SCTP_INTERLEAVING_SUPPORTED)
+static int interleave;
+#endif
+static int keep_associations;
+/* The last message sent doesn't end the association (-K, -H). */
+static int keep_open;
+static int duplex;
+static int setup_benchmark;
+static unsigned long setup_count;
+static unsigned long hold_target;
+static int backlog;
+static int cpu_cost;
+static int syscall_tracepoint = -1;
+static const char *cost_counter_names[] = { "cycles", "instructions", "cache_misses", "context_switches", "syscalls" };
+static int verify;
+static int one_way_latency;
+static int per_stream;
+static unsigned int *stream_weights;
+static unsigned int nr_stream_weights;
+static int stream_scheduler = -1;
+#if defined(SCTP_STREAM_SCHEDULER)
+/*
+ * Linux and the BSD stacks (and usrsctp) number and name their schedulers
+ * differently; Linux declares them as enumerators, which configure checks.
+ */
+static const struct {
+	const char *name;
+	uint32_t value;
+} stream_schedulers[] = {
+#if HAVE_DECL_SCTP_SS_DEFAULT || defined(SCTP_SS_DEFAULT)
+	{ "default", SCTP_SS_DEFAULT },
+#endif
+#if HAVE_DECL_SCTP_SS_FCFS
+	{ "fcfs", SCTP_SS_FCFS },
+#endif
+#if defined(SCTP_SS_FIRST_COME)
+	{ "fcfs", SCTP_SS_FIRST_COME },
+#endif
+#if HAVE_DECL_SCTP_SS_PRIO
+	{ "prio", SCTP_SS_PRIO },
+#endif
+#if defined(SCTP_SS_PRIORITY)
+	{ "prio", SCTP_SS_PRIORITY },
+#endif
+#if HAVE_DECL_SCTP_SS_RR
+	{ "rr", SCTP_SS_RR },
+#endif
+#if defined(SCTP_SS_ROUND_ROBIN)
+	{ "rr", SCTP_SS_ROUND_ROBIN },
+#endif
+#if defined(SCTP_SS_ROUND_ROBIN_PACKET)
+	{ "rrp", SCTP_SS_ROUND_ROBIN_PACKET },
+#endif
+#if HAVE_DECL_SCTP_SS_FC
+	{ "fc", SCTP_SS_FC },
+#endif
+#if defined(SCTP_SS_FAIR_BANDWITH)
+	{ "fb", SCTP_SS_FAIR_BANDWITH },
+#endif
+#if HAVE_DECL_SCTP_SS_WFQ
+	{ "wfq", SCTP_SS_WFQ },
+#endif
+};
+#endif
+static unsigned int *scheduler_values;
+static unsigned int nr_scheduler_values;
+static int stamp_messages;
+static int size_distribution;
+static unsigned int size_min, size_max;
+static double size_mean, size_fraction;
+static const char *trace_data;
+static size_t trace_size;
+static unsigned long trace_records;
+static double trace_bytes;
+static unsigned int coalesce_bytes;
+static unsigned int coalesce_usecs;
+static unsigned int piece_size;
+static struct sweep_parameter sweep[NUMBER_OF_SWEEP_PARAMETERS] = {
+	{ .name = "nodelay" }, { .name = "sndbuf" }, { .name = "streams" }, { .name = "length" },
+	{ .name = "policy" }, { .name = "prvalue" }, { .name = "coalesce" }
+};
+
+static pthread_barrier_t start_barrier;
+static pthread_mutex_t senders_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t senders_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int senders_running;
+#if defined(USRSCTP)
+static int loopback;
+#endif
+
+#if defined(USRSCTP)
+/*
+ * usrsctp backend: the userland stack hands out socket pointers instead
+ * of file descriptors. They are kept in a table, indexed by the integer
+ * used everywhere else, and the socket calls and the lksctp functions
+ * used below are provided on top of the usrsctp API.
+ */
+static struct socket *sockets[MAX_SOCKETS];
+static pthread_mutex_t sockets_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int socket_register(struct socket *so)
 {
-	done = 1;
+	int fd;
+
+	if (so == NULL) {
+		return -1;
+	}
+	pthread_mutex_lock(&sockets_mutex);
+	for (fd = 0; fd < MAX_SOCKETS && sockets[fd] != NULL; fd++);
+	if (fd < MAX_SOCKETS) {
+		sockets[fd] = so;
+	}
+	pthread_mutex_unlock(&sockets_mutex);
+	if (fd == MAX_SOCKETS) {
+		usrsctp_close(so);
+		errno = EMFILE;
+		return -1;
+	}
+	return fd;
 }
 
-static time_t calc_round_timeout(struct timeval round_start)
+static struct socket *socket_lookup(int fd)
 {
-	time_t round_timeout = round_start.tv_sec + round_duration;
-	if (round_start.tv_usec >= 500000) {
-		round_timeout++;
+	if (fd < 0 || fd >= MAX_SOCKETS) {
+		return NULL;
 	}
-	return round_timeout;
+	return sockets[fd];
 }
 
-static void* handle_connection(void *arg)
+static int tsctp_socket(int domain, int type, int protocol)
+{
+	return socket_register(usrsctp_socket(domain, type, protocol, NULL, NULL, 0, NULL));
+}
+
+static int tsctp_setsockopt(int fd, int level, int name, const void *value, socklen_t len)
+{
+	return usrsctp_setsockopt(socket_lookup(fd), level, name, value, len);
+}
+
+static int tsctp_getsockopt(int fd, int level, int name, void *value, socklen_t *len)
+{
+	return usrsctp_getsockopt(socket_lookup(fd), level, name, value, len);
+}
+
+static int tsctp_listen(int fd, int backlog)
+{
+	return usrsctp_listen(socket_lookup(fd), backlog);
+}
+
+static int tsctp_accept(int fd, struct sockaddr *addr, socklen_t *len)
+{
+	return socket_register(usrsctp_accept(socket_lookup(fd), addr, len));
+}
+
+static int tsctp_connect(int fd, struct sockaddr *addr, socklen_t len)
+{
+	return usrsctp_connect(socket_lookup(fd), addr, len);
+}
+
+static int tsctp_shutdown(int fd, int how)
+{
+	return usrsctp_shutdown(socket_lookup(fd), how);
+}
+
+static int close_socket(int fd)
+{
+	struct socket *so;
+
+	if ((so = socket_lookup(fd)) == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+	pthread_mutex_lock(&sockets_mutex);
+	sockets[fd] = NULL;
+	pthread_mutex_unlock(&sockets_mutex);
+	usrsctp_close(so);
+	return 0;
+}
+
+static int sctp_bindx(int fd, struct sockaddr *addrs, int addrcnt, int flags)
+{
+	return usrsctp_bindx(socket_lookup(fd), addrs, addrcnt, flags);
+}
+
+static int sctp_connectx(int fd, struct sockaddr *addrs, int addrcnt, sctp_assoc_t *id)
+{
+	return usrsctp_connectx(socket_lookup(fd), addrs, addrcnt, id);
+}
+
+static int sctp_getpaddrs(int fd, sctp_assoc_t id, struct sockaddr **addrs)
+{
+	return usrsctp_getpaddrs(socket_lookup(fd), id, addrs);
+}
+
+static void sctp_freepaddrs(struct sockaddr *addrs)
+{
+	usrsctp_freepaddrs(addrs);
+}
+
+static int sctp_opt_info(int fd, sctp_assoc_t id, int opt, void *arg, socklen_t *size)
+{
+	switch (opt) {
+	case SCTP_STATUS:
+		((struct sctp_status *)arg)->sstat_assoc_id = id;
+		break;
+	case SCTP_GET_PEER_ADDR_INFO:
+		((struct sctp_paddrinfo *)arg)->spinfo_assoc_id = id;
+		break;
+	default:
+		/* All other options used start with the association identifier. */
+		*(sctp_assoc_t *)arg = id;
+		break;
+	}
+	return usrsctp_getsockopt(socket_lookup(fd), IPPROTO_SCTP, opt, arg, size);
+}
+
+static int sctp_send(int fd, const void *msg, size_t len, const struct sctp_sndrcvinfo *sinfo, int flags)
+{
+	struct sctp_sendv_spa spa;
+
+	memset(&spa, 0, sizeof(spa));
+	spa.sendv_flags = SCTP_SEND_SNDINFO_VALID;
+	spa.sendv_sndinfo.snd_sid = sinfo->sinfo_stream;
+	/* As in the FreeBSD stack the PR-SCTP policy is kept in the lowest bits of the flags. */
+	spa.sendv_sndinfo.snd_flags = sinfo->sinfo_flags & ~0x000f;
+	spa.sendv_sndinfo.snd_ppid = sinfo->sinfo_ppid;
+	spa.sendv_sndinfo.snd_context = sinfo->sinfo_context;
+	spa.sendv_sndinfo.snd_assoc_id = sinfo->sinfo_assoc_id;
+	if ((sinfo->sinfo_flags & 0x000f) != SCTP_PR_SCTP_NONE) {
+		spa.sendv_flags |= SCTP_SEND_PRINFO_VALID;
+		spa.sendv_prinfo.pr_policy = sinfo->sinfo_flags & 0x000f;
+		spa.sendv_prinfo.pr_value = sinfo->sinfo_timetolive;
+	}
+	return (int)usrsctp_sendv(socket_lookup(fd), msg, len, NULL, 0, &spa, (socklen_t)sizeof(spa), SCTP_SENDV_SPA, flags);
+}
+
+static int sctp_sendmsg(int fd, const void *msg, size_t len, struct sockaddr *to, socklen_t tolen,
+                        uint32_t ppid, uint32_t flags, uint16_t stream_no, uint32_t timetolive, uint32_t context)
 {
 	struct sctp_sndrcvinfo sinfo;
+
+	memset(&sinfo, 0, sizeof(sinfo));
+	sinfo.sinfo_stream = stream_no;
+	sinfo.sinfo_flags = flags;
+	sinfo.sinfo_ppid = ppid;
+	sinfo.sinfo_context = context;
+	sinfo.sinfo_timetolive = timetolive;
+	return sctp_send(fd, msg, len, &sinfo, 0);
+}
+
+static int sctp_recvmsg(int fd, void *msg, size_t len, struct sockaddr *from, socklen_t *fromlen,
+                        struct sctp_sndrcvinfo *sinfo, int *msg_flags)
+{
+	struct sctp_rcvinfo rcv;
+	socklen_t infolen, addrlen;
+	unsigned int infotype;
 	ssize_t n;
-	unsigned long long sum = 0;
-	char *buf;
+
+	infolen = (socklen_t)sizeof(rcv);
+	infotype = 0;
+	addrlen = 0;
+	*msg_flags = 0;
+	n = usrsctp_recvv(socket_lookup(fd), msg, len, from, (fromlen != NULL) ? fromlen : &addrlen,
+	                  &rcv, &infolen, &infotype, msg_flags);
+	if (n >= 0 && sinfo != NULL) {
+		memset(sinfo, 0, sizeof(struct sctp_sndrcvinfo));
+		if (infotype == SCTP_RECVV_RCVINFO) {
+			sinfo->sinfo_stream = rcv.rcv_sid;
+			sinfo->sinfo_ssn = rcv.rcv_ssn;
+			sinfo->sinfo_flags = rcv.rcv_flags;
+			sinfo->sinfo_ppid = rcv.rcv_ppid;
+			sinfo->sinfo_context = rcv.rcv_context;
+			sinfo->sinfo_tsn = rcv.rcv_tsn;
+			sinfo->sinfo_cumtsn = rcv.rcv_cumtsn;
+			sinfo->sinfo_assoc_id = rcv.rcv_assoc_id;
+		}
+	}
+	return (int)n;
+}
+
+#define socket(domain, type, protocol)           tsctp_socket(domain, type, protocol)
+#define setsockopt(fd, level, name, value, len)  tsctp_setsockopt(fd, level, name, value, len)
+#define getsockopt(fd, level, name, value, len)  tsctp_getsockopt(fd, level, name, value, len)
+#define listen(fd, backlog)                      tsctp_listen(fd, backlog)
+#define accept(fd, addr, len)                    tsctp_accept(fd, addr, len)
+#define connect(fd, addr, len)                   tsctp_connect(fd, addr, len)
+#define shutdown(fd, how)                        tsctp_shutdown(fd, how)
+
+/*
+ * Memory conduit of the in-process loopback. Each end is registered as an
+ * address of the stack. Packets sent to an end are queued for the other
+ * one and fed back into the stack by a thread per end, since the stack
+ * must not be entered again from its output routine.
+ */
+struct packet {
+	struct packet *next;
+	size_t length;
+	char data[];
+};
+
+struct conduit {
+	struct conduit *peer;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct packet *head;
+	struct packet *tail;
 	pthread_t tid;
-	int fd;
-	struct timeval start_time, now, diff_time;
-	double seconds;
-	unsigned long messages = 0;
-	unsigned long recv_calls = 0;
-	unsigned long notifications = 0;
-	unsigned int first_length;
-	int flags;
-	socklen_t len;
-	unsigned long round_bytes;
-	struct timeval round_start;
-	time_t round_timeout;
+};
 
-	fd = *(int *) arg;
-	free(arg);
-	tid = pthread_self();
-	pthread_detach(tid);
+static struct conduit conduits[2];
+static pthread_mutex_t loopback_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t loopback_cond = PTHREAD_COND_INITIALIZER;
+static unsigned long loopback_opened, loopback_finished;
 
-	buf = malloc(BUFFERSIZE);
-	flags = 0;
-	len = (socklen_t)0;
-	n = sctp_recvmsg(fd, (void*)buf, BUFFERSIZE, NULL, &len, &sinfo, &flags);
-	gettimeofday(&start_time, NULL);
-	first_length = 0;
-	if (round_duration > 0) {
-		round_bytes = 0;
-		gettimeofday(&round_start, NULL);
-		round_timeout = calc_round_timeout(round_start);
+static int conduit_output(void *addr, void *buffer, size_t length, uint8_t tos, uint8_t set_df)
+{
+	struct conduit *conduit;
+	struct packet *packet;
+
+	conduit = ((struct conduit *)addr)->peer;
+	if ((packet = malloc(sizeof(struct packet) + length)) == NULL) {
+		return ENOMEM;
 	}
-	while (n > 0) {
-		recv_calls++;
-		if (flags & MSG_NOTIFICATION) {
-			notifications++;
-		} else {
-			if (very_verbose) {
-				printf("%s message of length %6zd, PPID = 0x%08x, SID = 0x%04x, SSN = 0x%04x, TSN = 0x%08x, %s.\n",
-				       flags & MSG_EOR ? "Final" : "Partial",
-				       n,
-				       ntohl(sinfo.sinfo_ppid),
-				       sinfo.sinfo_stream,
-				       sinfo.sinfo_ssn,
-				       sinfo.sinfo_tsn,
-				       sinfo.sinfo_flags & SCTP_UNORDERED ? "unordered" : "ordered");
-			}
-			sum += n;
-			if (flags & MSG_EOR) {
-				messages++;
-				if (first_length == 0)
-					first_length = sum;
-				if (round_duration > 0)
-					round_bytes += first_length;
-			}
-		}
-		if (round_duration > 0 && round_timeout <= time(NULL)) {
-			gettimeofday(&now, NULL);
-			timersub(&now, &round_start, &diff_time);
-			seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000.0;
-			fprintf(stdout, "throughput for the last %f seconds: %f B/s\n", seconds, (double)round_bytes / seconds);
+	packet->next = NULL;
+	packet->length = length;
+	memcpy(packet->data, buffer, length);
+	pthread_mutex_lock(&conduit->mutex);
+	if (conduit->tail == NULL) {
+		conduit->head = packet;
+	} else {
+		conduit->tail->next = packet;
+	}
+	conduit->tail = packet;
+	pthread_cond_signal(&conduit->cond);
+	pthread_mutex_unlock(&conduit->mutex);
+	return 0;
+}
+
+static void* conduit_input(void *arg)
+{
+	struct conduit *conduit;
+	struct packet *packet, *next;
 
-			round_bytes = 0;
-			gettimeofday(&round_start, NULL);
-			round_timeout = calc_round_timeout(round_start);
+	conduit = (struct conduit *)arg;
+	while (1) {
+		pthread_mutex_lock(&conduit->mutex);
+		while (conduit->head == NULL) {
+			pthread_cond_wait(&conduit->cond, &conduit->mutex);
+		}
+		packet = conduit->head;
+		conduit->head = NULL;
+		conduit->tail = NULL;
+		pthread_mutex_unlock(&conduit->mutex);
+		for (; packet != NULL; packet = next) {
+			next = packet->next;
+			usrsctp_conninput(conduit, packet->data, packet->length, 0);
+			free(packet);
 		}
-		flags = 0;
-		len = (socklen_t)0;
-		n = sctp_recvmsg(fd, (void*)buf, BUFFERSIZE, NULL, &len, &sinfo, &flags);
 	}
-	if (n < 0)
-		perror("sctp_recvmsg");
-	gettimeofday(&now, NULL);
-	timersub(&now, &start_time, &diff_time);
-	seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000.0;
-	fprintf(stdout, "%u, %lu, %lu, %lu, %llu, %f, %f\n",
-	        first_length, messages, recv_calls, notifications, sum, seconds, (double)first_length * (double)messages / seconds);
-	fflush(stdout);
-	close(fd);
-	free(buf);
 	return NULL;
 }
 
-int main(int argc, char **argv)
+static void start_conduits(void)
 {
-	int fd, *cfdptr, c;
-	size_t intlen;
-	char *buffer;
-	socklen_t addr_len;
-	union sock_union{
-		struct sockaddr sa;
-		struct sockaddr_in s4;
-		struct sockaddr_in6 s6;
-	} remote_addr;
-	struct sockaddr_storage local_addr[MAX_LOCAL_ADDR];
-	char *local_addr_ptr = (char*) local_addr;
-	unsigned int nr_local_addr = 0;
-	struct timeval start_time, now, diff_time;
-	int length, client;
-	uint16_t local_port, remote_port, port;
-#ifdef SCTP_REMOTE_UDP_ENCAPS_PORT
-	uint16_t udp_port = 0;
-	struct sctp_udpencaps encaps;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		conduits[i].peer = &conduits[1 - i];
+		pthread_mutex_init(&conduits[i].mutex, NULL);
+		pthread_cond_init(&conduits[i].cond, NULL);
+		usrsctp_register_address(&conduits[i]);
+		if (pthread_create(&conduits[i].tid, NULL, &conduit_input, (void *)&conduits[i]) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	/* Like the kernel on the loopback interface, leave the CRC32c to the missing hardware. */
+	usrsctp_enable_crc32c_offload();
+}
+
+/*
+ * End 0 of the memory conduit belongs to the client, end 1 to the server.
+ * Each side addresses its peer by its own end.
+ */
+static socklen_t loopback_address(union sock_union *addr, uint16_t port, int end)
+{
+	memset(addr, 0, sizeof(union sock_union));
+	if (loopback == LOOPBACK_MEMORY) {
+		addr->sconn.sconn_family = AF_CONN;
+		addr->sconn.sconn_port = htons(port);
+		addr->sconn.sconn_addr = &conduits[end];
+		return (socklen_t)sizeof(struct sockaddr_conn);
+	} else if (ipv6only) {
+		addr->s6.sin6_family = AF_INET6;
+#ifdef HAVE_SIN_LEN
+		addr->s6.sin6_len = sizeof(struct sockaddr_in6);
 #endif
-	double seconds;
-	double throughput;
-	const int on = 1;
-	const int off = 0;
-	int nodelay = 0;
-	unsigned long i, number_of_messages;
-	pthread_t tid;
-	int rcvbufsize=0, sndbufsize=0, myrcvbufsize, mysndbufsize;
-	struct linger linger;
-	int fragpoint = 0;
-	unsigned int timetolive = 0;
-	unsigned int runtime = 0;
-	int policy = 0;
-	struct sctp_setadaptation ind = {0};
-#ifdef SCTP_AUTH_CHUNK
-	unsigned int number_of_chunks_to_auth = 0;
-	unsigned int chunk_number;
-	unsigned char chunk[256];
-	struct sctp_authchunk sac;
+		addr->s6.sin6_port = htons(port);
+		addr->s6.sin6_addr = in6addr_loopback;
+		return (socklen_t)sizeof(struct sockaddr_in6);
+	} else {
+		addr->s4.sin_family = AF_INET;
+#ifdef HAVE_SIN_LEN
+		addr->s4.sin_len = sizeof(struct sockaddr_in);
 #endif
-	struct sctp_assoc_value av;
-	int unordered = 0;
-	int ipv4only = 0;
-	int ipv6only = 0;
-#if defined(SCTP_INTERLEAVING_SUPPORTED)
-	int interleave = 0;
+		addr->s4.sin_port = htons(port);
+		addr->s4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		return (socklen_t)sizeof(struct sockaddr_in);
+	}
+}
+
+/* The client waits for the server to report each association it opened. */
+static void loopback_count(unsigned long *counter)
+{
+	pthread_mutex_lock(&loopback_mutex);
+	(*counter)++;
+	pthread_cond_broadcast(&loopback_cond);
+	pthread_mutex_unlock(&loopback_mutex);
+}
+
+static void loopback_wait(void)
+{
+	pthread_mutex_lock(&loopback_mutex);
+	while (loopback_finished < loopback_opened) {
+		pthread_cond_wait(&loopback_cond, &loopback_mutex);
+	}
+	pthread_mutex_unlock(&loopback_mutex);
+}
+#else
+#define close_socket(fd) close(fd)
 #endif
-	uint16_t streams, sid;
-	struct sctp_initmsg init;
 
-	streams            = 1;
-	length             = DEFAULT_LENGTH;
-	number_of_messages = DEFAULT_NUMBER_OF_MESSAGES;
-	port               = DEFAULT_PORT;
-	verbose            = 0;
-	very_verbose       = 0;
-	round_duration     = 0;
+void stop_sender(int sig)
+{
+	done = 1;
+}
 
-	memset((void *) &remote_addr, 0, sizeof(remote_addr));
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
 
-	while ((c = getopt(argc, argv, "a:"
-#ifdef SCTP_AUTH_CHUNK
-	                               "A:"
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Log-linear histogram: values below HISTOGRAM_SUB_BUCKETS are counted
+ * exactly, every further power of two is split into HISTOGRAM_SUB_BUCKETS
+ * linear buckets. This bounds the relative error by 1/HISTOGRAM_SUB_BUCKETS
+ * and makes adding a value a few instructions.
+ */
+static unsigned int histogram_index(uint64_t value)
+{
+	unsigned int msb, shift;
+
+	if (value < HISTOGRAM_SUB_BUCKETS) {
+		return (unsigned int)value;
+	}
+#if defined(__GNUC__)
+	msb = 63 - __builtin_clzll(value);
+#else
+	for (msb = 63; (value & (1ULL << msb)) == 0; msb--);
 #endif
-	                               "d:Df:"
+	shift = msb - HISTOGRAM_SUB_BITS;
+	return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (unsigned int)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+static uint64_t histogram_value(unsigned int index)
+{
+	unsigned int shift;
+
+	if (index < HISTOGRAM_SUB_BUCKETS) {
+		return index;
+	}
+	shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+	/* Report the middle of the bucket. */
+	return ((uint64_t)(index % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS) << shift) + ((1ULL << shift) >> 1);
+}
+
+static void histogram_add(struct histogram *h, uint64_t value)
+{
+	if (h->count == 0 || value < h->min) {
+		h->min = value;
+	}
+	if (value > h->max) {
+		h->max = value;
+	}
+	h->count++;
+	h->buckets[histogram_index(value)]++;
+}
+
+static void histogram_merge(struct histogram *dst, const struct histogram *src)
+{
+	unsigned int i;
+
+	if (src->count == 0) {
+		return;
+	}
+	if (dst->count == 0 || src->min < dst->min) {
+		dst->min = src->min;
+	}
+	if (src->max > dst->max) {
+		dst->max = src->max;
+	}
+	dst->count += src->count;
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		dst->buckets[i] += src->buckets[i];
+	}
+}
+
+static uint64_t histogram_percentile(const struct histogram *h, double percentile)
+{
+	uint64_t rank, seen;
+	unsigned int i;
+
+	if (h->count == 0) {
+		return 0;
+	}
+	rank = (uint64_t)(percentile / 100.0 * (double)h->count);
+	if (rank >= h->count) {
+		return h->max;
+	}
+	seen = 0;
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen > rank) {
+			break;
+		}
+	}
+	if (histogram_value(i) < h->min) {
+		return h->min;
+	}
+	if (histogram_value(i) > h->max) {
+		return h->max;
+	}
+	return histogram_value(i);
+}
+
+static void print_histogram(const char *prefix, const char *name, const struct histogram *h)
+{
+	fprintf(stdout, "%s%s (usec): min %.1f, p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f.\n",
+	        prefix, name,
+	        h->min / 1000.0,
+	        histogram_percentile(h, 50.0) / 1000.0,
+	        histogram_percentile(h, 99.0) / 1000.0,
+	        histogram_percentile(h, 99.9) / 1000.0,
+	        h->max / 1000.0);
+}
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+static int open_counter(uint32_t type, uint64_t config, int exclude_kernel)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = exclude_kernel;
+	attr.exclude_hv = 1;
+	/* The calling thread on any CPU. */
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* The identifier of the raw_syscalls:sys_enter tracepoint, -1 if it is not accessible. */
+static int find_syscall_tracepoint(void)
+{
+	const char *paths[] = { "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+	                        "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id" };
+	unsigned int i;
+	FILE *f;
+	int id;
+
+	for (i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+		if ((f = fopen(paths[i], "r")) == NULL) {
+			continue;
+		}
+		if (fscanf(f, "%d", &id) != 1) {
+			id = -1;
+		}
+		fclose(f);
+		if (id >= 0) {
+			return id;
+		}
+	}
+	return -1;
+}
+#endif
+
+/*
+ * Starts accounting the CPU used by the calling thread. If counting in
+ * the kernel is not permitted, the hardware counters fall back to user
+ * space, which misses most of the work of the kernel stack.
+ */
+static void cost_start(struct cpu_cost *c)
+{
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+	static const uint32_t types[NUMBER_OF_COST_COUNTERS] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE, PERF_TYPE_TRACEPOINT
+	};
+	static const uint64_t configs[NUMBER_OF_COST_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES, 0
+	};
+	unsigned int i;
+#endif
+#if defined(RUSAGE_THREAD)
+	struct rusage usage;
+#endif
+
+	memset(c, 0, sizeof(struct cpu_cost));
+	c->missing = (1U << NUMBER_OF_COST_COUNTERS) - 1;
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+	for (i = 0; i < NUMBER_OF_COST_COUNTERS; i++) {
+		c->fds[i] = -1;
+		if (i == COST_SYSCALLS) {
+			if (syscall_tracepoint >= 0) {
+				c->fds[i] = open_counter(PERF_TYPE_TRACEPOINT, (uint64_t)syscall_tracepoint, 0);
+			}
+			continue;
+		}
+		if (!c->user_only) {
+			c->fds[i] = open_counter(types[i], configs[i], 0);
+		}
+		if (c->fds[i] < 0 && types[i] == PERF_TYPE_HARDWARE) {
+			if ((c->fds[i] = open_counter(types[i], configs[i], 1)) >= 0) {
+				c->user_only = 1;
+			}
+		}
+	}
+#else
+	memset(c->fds, -1, sizeof(c->fds));
+#endif
+#if defined(RUSAGE_THREAD)
+	if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+		c->user = usage.ru_utime;
+		c->system = usage.ru_stime;
+		c->context_switches = usage.ru_nvcsw + usage.ru_nivcsw;
+	}
+#endif
+}
+
+static void cost_stop(struct cpu_cost *c, unsigned long long bytes, unsigned long messages, unsigned long calls)
+{
+	unsigned int i;
+	uint64_t value;
+#if defined(RUSAGE_THREAD)
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+		timersub(&usage.ru_utime, &c->user, &c->user);
+		timersub(&usage.ru_stime, &c->system, &c->system);
+		/* Used unless the counter below can be read. */
+		c->counters[COST_CONTEXT_SWITCHES] = usage.ru_nvcsw + usage.ru_nivcsw - c->context_switches;
+		c->missing &= ~(1U << COST_CONTEXT_SWITCHES);
+	}
+#endif
+	for (i = 0; i < NUMBER_OF_COST_COUNTERS; i++) {
+		if (c->fds[i] < 0) {
+			continue;
+		}
+		if (read(c->fds[i], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+			c->counters[i] = value;
+			c->missing &= ~(1U << i);
+		}
+		close(c->fds[i]);
+		c->fds[i] = -1;
+	}
+	c->bytes = bytes;
+	c->messages = messages;
+	c->calls = calls;
+}
+
+static void cost_merge(struct cpu_cost *dst, const struct cpu_cost *src, int first)
+{
+	unsigned int i;
+
+	if (first) {
+		memset(dst, 0, sizeof(struct cpu_cost));
+	}
+	timeradd(&dst->user, &src->user, &dst->user);
+	timeradd(&dst->system, &src->system, &dst->system);
+	for (i = 0; i < NUMBER_OF_COST_COUNTERS; i++) {
+		dst->counters[i] += src->counters[i];
+	}
+	dst->missing |= src->missing;
+	dst->user_only |= src->user_only;
+	dst->bytes += src->bytes;
+	dst->messages += src->messages;
+	dst->calls += src->calls;
+}
+
+static void print_cost(const char *prefix, const struct cpu_cost *c)
+{
+	double cycles;
+
+	fprintf(stdout, "%sCPU time: user %f sec, system %f sec",
+	        prefix,
+	        c->user.tv_sec + c->user.tv_usec / 1000000.0,
+	        c->system.tv_sec + c->system.tv_usec / 1000000.0);
+	if (!(c->missing & (1U << COST_CONTEXT_SWITCHES))) {
+		fprintf(stdout, ", %llu context switches", (unsigned long long)c->counters[COST_CONTEXT_SWITCHES]);
+	}
+	if (c->messages > 0) {
+		fprintf(stdout, ", %f socket calls/message", (double)c->calls / c->messages);
+		if (!(c->missing & (1U << COST_SYSCALLS))) {
+			fprintf(stdout, ", %f system calls/message", (double)c->counters[COST_SYSCALLS] / c->messages);
+		}
+	}
+	fprintf(stdout, ".\n");
+	if (c->missing & (1U << COST_CYCLES)) {
+		return;
+	}
+	cycles = (double)c->counters[COST_CYCLES];
+	fprintf(stdout, "%s%s%f cycles/byte, %f cycles/message",
+	        prefix, c->user_only ? "User space only: " : "",
+	        (c->bytes > 0) ? cycles / c->bytes : 0.0,
+	        (c->messages > 0) ? cycles / c->messages : 0.0);
+	if (!(c->missing & (1U << COST_INSTRUCTIONS)) && cycles > 0.0) {
+		fprintf(stdout, ", %f instructions/cycle", (double)c->counters[COST_INSTRUCTIONS] / cycles);
+	}
+	if (!(c->missing & (1U << COST_CACHE_MISSES))) {
+		fprintf(stdout, ", %llu cache misses", (unsigned long long)c->counters[COST_CACHE_MISSES]);
+	}
+	fprintf(stdout, ".\n");
+}
+
+/* The largest resident size of this process so far, in bytes. */
+static double peak_memory(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0) {
+		return -1.0;
+	}
+#if defined(__APPLE__)
+	return (double)usage.ru_maxrss;
+#else
+	return (double)usage.ru_maxrss * 1024.0;
+#endif
+}
+
+/*
+ * Fletcher style checksum over the bytes of a message, computed in
+ * CHECKSUM_LANES independent lanes. The inner loop has no dependencies
+ * between lanes, so the compiler turns it into vector instructions. The
+ * sums are reduced every CHECKSUM_REDUCE blocks, which keeps them within
+ * 32 bits. Data may be passed in pieces of any size.
+ */
+static void checksum_init(struct checksum *c)
+{
+	memset(c, 0, sizeof(struct checksum));
+}
+
+static void checksum_blocks(struct checksum *c, const unsigned char *p, size_t blocks)
+{
+	unsigned int j;
+
+	while (blocks-- > 0) {
+		for (j = 0; j < CHECKSUM_LANES; j++) {
+			c->a[j] += p[j];
+			c->b[j] += c->a[j];
+		}
+		p += CHECKSUM_LANES;
+		if (++c->blocks == CHECKSUM_REDUCE) {
+			for (j = 0; j < CHECKSUM_LANES; j++) {
+				c->a[j] %= CHECKSUM_MODULUS;
+				c->b[j] %= CHECKSUM_MODULUS;
+			}
+			c->blocks = 0;
+		}
+	}
+}
+
+static void checksum_update(struct checksum *c, const char *buf, size_t len)
+{
+	const unsigned char *p;
+	size_t n;
+
+	p = (const unsigned char *)buf;
+	c->length += len;
+	if (c->pending > 0) {
+		n = CHECKSUM_LANES - c->pending;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(c->tail + c->pending, p, n);
+		c->pending += n;
+		p += n;
+		len -= n;
+		if (c->pending < CHECKSUM_LANES) {
+			return;
+		}
+		checksum_blocks(c, c->tail, 1);
+		c->pending = 0;
+	}
+	checksum_blocks(c, p, len / CHECKSUM_LANES);
+	c->pending = len % CHECKSUM_LANES;
+	memcpy(c->tail, p + len - c->pending, c->pending);
+}
+
+static uint32_t checksum_final(struct checksum *c)
+{
+	uint32_t sum;
+	unsigned int j;
+
+	if (c->pending > 0) {
+		memset(c->tail + c->pending, 0, CHECKSUM_LANES - c->pending);
+		checksum_blocks(c, c->tail, 1);
+	}
+	sum = (uint32_t)c->length;
+	for (j = 0; j < CHECKSUM_LANES; j++) {
+		sum = sum * 31 + ((c->b[j] % CHECKSUM_MODULUS) << 16 | (c->a[j] % CHECKSUM_MODULUS));
+	}
+	return sum;
+}
+
+/* Covers the header fields, except the checksum field itself. */
+static uint32_t payload_checksum(uint32_t body, const struct payload_header *h)
+{
+	return body ^
+	       (ntohl(h->seq) * 2654435761U) ^
+	       ((uint32_t)ntohs(h->sid) << 16 | ntohs(h->flags)) ^
+	       (ntohl(h->time_high) * 40503U) ^
+	       ntohl(h->time_low);
+}
+
+/* When messages are sent in pieces, the buffer holds one piece, which is sent repeatedly. */
+static uint32_t body_checksum(const char *buffer, int len)
+{
+	struct checksum c;
+	size_t size, offset, part;
+
+	size = (piece_size > 0) ? piece_size : (size_t)len;
+	checksum_init(&c);
+	for (offset = PAYLOAD_HEADER_SIZE; offset < (size_t)len; offset += part) {
+		part = size - offset % size;
+		if (part > (size_t)len - offset) {
+			part = (size_t)len - offset;
+		}
+		checksum_update(&c, buffer + offset % size, part);
+	}
+	return checksum_final(&c);
+}
+
+static void stamp_payload(char *buf, uint16_t sid, uint32_t seq, uint32_t body)
+{
+	struct payload_header h;
+	uint64_t now;
+
+	now = now_ns();
+	h.magic = htonl(PAYLOAD_MAGIC);
+	h.sid = htons(sid);
+	h.flags = htons(pr_policy != 0 ? PAYLOAD_FLAG_PR : 0);
+	h.seq = htonl(seq);
+	h.time_high = htonl((uint32_t)(now >> 32));
+	h.time_low = htonl((uint32_t)now);
+	h.checksum = 0;
+	h.checksum = htonl(payload_checksum(body, &h));
+	memcpy(buf, &h, sizeof(struct payload_header));
+}
+
+/*
+ * Accounts a sequence number received on a stream. Sequence numbers
+ * above all previous ones advance the window, the others are
+ * duplicates or arrived out of order.
+ */
+static void stream_account(struct stream_stats *s, uint32_t seq)
+{
+	int32_t delta;
+	uint32_t j, distance;
+
+	delta = (int32_t)(seq - s->next_seq);
+	if (delta >= 0) {
+		if (delta >= REORDER_WINDOW) {
+			memset(s->window, 0, sizeof(s->window));
+		} else {
+			for (j = s->next_seq; j != seq; j++) {
+				s->window[(j % REORDER_WINDOW) / 64] &= ~(1ULL << (j % 64));
+			}
+		}
+		s->window[(seq % REORDER_WINDOW) / 64] |= 1ULL << (seq % 64);
+		s->next_seq = seq + 1;
+		s->expected += (unsigned long long)delta + 1;
+		s->received++;
+		return;
+	}
+	distance = (uint32_t)-delta;
+	if (distance > REORDER_WINDOW) {
+		s->too_old++;
+		return;
+	}
+	if (s->window[(seq % REORDER_WINDOW) / 64] & (1ULL << (seq % 64))) {
+		s->duplicates++;
+		return;
+	}
+	s->window[(seq % REORDER_WINDOW) / 64] |= 1ULL << (seq % 64);
+	/* The number of later messages which were received before this one. */
+	distance--;
+	s->received++;
+	s->out_of_order++;
+	s->total_reorder += distance;
+	if (distance > s->max_reorder) {
+		s->max_reorder = distance;
+	}
+}
+
+/* Messages not received below the highest one, those arriving too late count as received. */
+static unsigned long long stream_missing(const struct stream_stats *s)
+{
+	if (s->expected <= s->received + s->too_old) {
+		return 0;
+	}
+	return s->expected - s->received - s->too_old;
+}
+
+static void verifier_update(struct verifier *v, const char *buf, size_t n)
+{
+	size_t header_part;
+
+	if (v->header_bytes < sizeof(struct payload_header)) {
+		header_part = sizeof(struct payload_header) - v->header_bytes;
+		if (header_part > n) {
+			header_part = n;
+		}
+		memcpy(v->header + v->header_bytes, buf, header_part);
+		v->header_bytes += header_part;
+		buf += header_part;
+		n -= header_part;
+	}
+	if (verify) {
+		checksum_update(&v->checksum, buf, n);
+	}
+}
+
+/*
+ * Called at the end of each message, returns the one-way latency in ns or
+ * -1 if it is not measured. The one-way latency is the time from
+ * handing the message to the kernel until it was received completely; it
+ * is only meaningful if both ends share CLOCK_MONOTONIC, as on loopback or
+ * between network namespaces of one host.
+ */
+static int64_t verifier_complete(struct verifier *v)
+{
+	struct payload_header h;
+	struct stream_stats *s;
+	uint64_t now, sent;
+	int64_t latency;
+	uint16_t sid;
+
+	latency = -1;
+	memcpy(&h, v->header, sizeof(struct payload_header));
+	if (v->header_bytes < sizeof(struct payload_header) || ntohl(h.magic) != PAYLOAD_MAGIC) {
+		v->invalid++;
+		goto out;
+	}
+	if (!verify) {
+		goto latency;
+	}
+	sid = ntohs(h.sid);
+	/* The stream of a corrupted message is only trusted if it is already known. */
+	if (payload_checksum(checksum_final(&v->checksum), &h) != ntohl(h.checksum)) {
+		if (sid < v->nr_streams) {
+			v->streams[sid].corrupted++;
+		} else {
+			v->invalid++;
+		}
+		goto out;
+	}
+	if (sid >= v->max_streams) {
+		v->invalid++;
+		goto out;
+	}
+	if (sid >= v->nr_streams) {
+		if ((s = realloc(v->streams, (sid + 1) * sizeof(struct stream_stats))) == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+		v->streams = s;
+		memset(v->streams + v->nr_streams, 0, (sid + 1 - v->nr_streams) * sizeof(struct stream_stats));
+		v->nr_streams = sid + 1;
+	}
+	s = &v->streams[sid];
+	s->pr = (ntohs(h.flags) & PAYLOAD_FLAG_PR) != 0;
+	stream_account(s, ntohl(h.seq));
+latency:
+	if (one_way_latency) {
+		now = now_ns();
+		sent = (uint64_t)ntohl(h.time_high) << 32 | ntohl(h.time_low);
+		if (now >= sent) {
+			latency = (int64_t)(now - sent);
+			histogram_add(&v->latency, now - sent);
+			histogram_add(&v->round_latency, now - sent);
+		}
+	}
+out:
+	v->header_bytes = 0;
+	checksum_init(&v->checksum);
+	return latency;
+}
+
+/*
+ * Sleep until the next burst of messages is due. The schedule is absolute,
+ * so a sender which fell behind catches up instead of drifting, and the
+ * time it was late is accounted for.
+ */
+static unsigned int pacer_wait(struct pacer *p)
+{
+	struct timespec ts;
+	uint64_t now;
+
+	now = now_ns();
+	if (p->next == 0) {
+		p->next = now;
+	}
+	if (now < p->next) {
+		ts.tv_sec = p->next / 1000000000ULL;
+		ts.tv_nsec = p->next % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !done);
+	} else if (now > p->next) {
+		p->late++;
+		p->total_lag += now - p->next;
+		if (now - p->next > p->max_lag) {
+			p->max_lag = now - p->next;
+		}
+	}
+	p->next += p->interval;
+	return burst;
+}
+
+static void print_csv_header(void)
+{
+	fprintf(stdout, "timestamp,side,type,assoc_id,bytes,messages,recv_calls,notifications,seconds,byte_rate,message_rate,"
+	                "latency_min_us,latency_p50_us,latency_p99_us,latency_p999_us,latency_max_us,"
+	                "stream,received,lost,abandoned,duplicates,out_of_order,max_reorder,mean_reorder,corrupted,failures,process_bytes_per_assoc,system_bytes_per_assoc,"
+	                "cpu_user_s,cpu_system_s,cycles,instructions,cache_misses,context_switches,syscalls,"
+	                "enqueued_seconds,enqueued_byte_rate,pr_abandoned_unsent,pr_abandoned_sent,user_messages,peak_memory,auth_data,associations,too_old\n");
+	fflush(stdout);
+}
+
+/*
+ * Prints one interval or result record in CSV or JSON lines format. The
+ * latency fields are only filled if a histogram is given, the stream
+ * fields only for the verification results of a stream.
+ */
+static void print_record(const struct record *rec)
+{
+	const struct stream_stats *s;
+	const struct cpu_cost *c;
+	unsigned int i;
+	struct timeval now;
+	double timestamp;
+	double byte_rate, message_rate;
+	unsigned long long missing;
+
+	gettimeofday(&now, NULL);
+	timestamp = now.tv_sec + (double)now.tv_usec/1000000.0;
+	byte_rate = (rec->seconds > 0.0) ? (double)rec->bytes / rec->seconds : 0.0;
+	message_rate = (rec->seconds > 0.0) ? (double)rec->messages / rec->seconds : 0.0;
+	flockfile(stdout);
+	if (output_format == OUTPUT_CSV) {
+		fprintf(stdout, "%f,%s,%s,%lld,%llu,%lu,%lu,%lu,%f,%f,%f",
+		        timestamp, rec->side, rec->type, rec->assoc_id, rec->bytes, rec->messages,
+		        rec->recv_calls, rec->notifications, rec->seconds, byte_rate, message_rate);
+		if (rec->latency != NULL && rec->latency->count > 0) {
+			fprintf(stdout, ",%.1f,%.1f,%.1f,%.1f,%.1f",
+			        rec->latency->min / 1000.0,
+			        histogram_percentile(rec->latency, 50.0) / 1000.0,
+			        histogram_percentile(rec->latency, 99.0) / 1000.0,
+			        histogram_percentile(rec->latency, 99.9) / 1000.0,
+			        rec->latency->max / 1000.0);
+		} else {
+			fprintf(stdout, ",,,,,");
+		}
+		if (rec->has_stream) {
+			fprintf(stdout, ",%u", rec->stream);
+		} else {
+			fprintf(stdout, ",");
+		}
+		if ((s = rec->verification) != NULL) {
+			missing = stream_missing(s);
+			fprintf(stdout, ",%llu,%llu,%llu,%lu,%lu,%lu,%f,%lu",
+			        s->received, s->pr ? 0 : missing, s->pr ? missing : 0,
+			        s->duplicates, s->out_of_order, s->max_reorder,
+			        s->out_of_order > 0 ? (double)s->total_reorder / s->out_of_order : 0.0,
+			        s->corrupted);
+		} else {
+			fprintf(stdout, ",,,,,,,,");
+		}
+		if (rec->has_setup) {
+			fprintf(stdout, ",%lu,", rec->failures);
+			if (rec->process_memory >= 0.0) {
+				fprintf(stdout, "%f,%f", rec->process_memory, rec->system_memory);
+			} else {
+				fprintf(stdout, ",");
+			}
+		} else {
+			fprintf(stdout, ",,,");
+		}
+		if ((c = rec->cost) != NULL) {
+			fprintf(stdout, ",%f,%f",
+			        c->user.tv_sec + c->user.tv_usec / 1000000.0,
+			        c->system.tv_sec + c->system.tv_usec / 1000000.0);
+			for (i = 0; i < NUMBER_OF_COST_COUNTERS; i++) {
+				if (c->missing & (1U << i)) {
+					fprintf(stdout, ",");
+				} else {
+					fprintf(stdout, ",%llu", (unsigned long long)c->counters[i]);
+				}
+			}
+		} else {
+			fprintf(stdout, ",,,,,,,");
+		}
+		if (rec->enqueued_seconds > 0.0) {
+			fprintf(stdout, ",%f,%f", rec->enqueued_seconds, (double)rec->bytes / rec->enqueued_seconds);
+		} else {
+			fprintf(stdout, ",,");
+		}
+		if (rec->abandoned != NULL) {
+			fprintf(stdout, ",%llu,%llu",
+			        (unsigned long long)rec->abandoned->unsent, (unsigned long long)rec->abandoned->sent);
+		} else {
+			fprintf(stdout, ",,");
+		}
+		if (rec->user_messages > 0) {
+			fprintf(stdout, ",%lu", rec->user_messages);
+		} else {
+			fprintf(stdout, ",");
+		}
+		if (rec->peak_memory > 0.0) {
+			fprintf(stdout, ",%.0f", rec->peak_memory);
+		} else {
+			fprintf(stdout, ",");
+		}
+		if (rec->has_auth) {
+			fprintf(stdout, ",%d", rec->auth_data);
+		} else {
+			fprintf(stdout, ",");
+		}
+		if (rec->has_associations) {
+			fprintf(stdout, ",%u", rec->associations);
+		} else {
+			fprintf(stdout, ",");
+		}
+		if ((s = rec->verification) != NULL) {
+			fprintf(stdout, ",%lu\n", s->too_old);
+		} else {
+			fprintf(stdout, ",\n");
+		}
+	} else {
+		fprintf(stdout, "{\"timestamp\": %f, \"side\": \"%s\", \"type\": \"%s\", \"assoc_id\": %lld, "
+		                "\"bytes\": %llu, \"messages\": %lu, \"recv_calls\": %lu, \"notifications\": %lu, "
+		                "\"seconds\": %f, \"byte_rate\": %f, \"message_rate\": %f",
+		        timestamp, rec->side, rec->type, rec->assoc_id, rec->bytes, rec->messages,
+		        rec->recv_calls, rec->notifications, rec->seconds, byte_rate, message_rate);
+		if (rec->latency != NULL && rec->latency->count > 0) {
+			fprintf(stdout, ", \"latency_us\": {\"min\": %.1f, \"p50\": %.1f, \"p99\": %.1f, \"p99.9\": %.1f, \"max\": %.1f}",
+			        rec->latency->min / 1000.0,
+			        histogram_percentile(rec->latency, 50.0) / 1000.0,
+			        histogram_percentile(rec->latency, 99.0) / 1000.0,
+			        histogram_percentile(rec->latency, 99.9) / 1000.0,
+			        rec->latency->max / 1000.0);
+		}
+		if (rec->has_stream) {
+			fprintf(stdout, ", \"stream\": %u", rec->stream);
+		}
+		if ((s = rec->verification) != NULL) {
+			missing = stream_missing(s);
+			fprintf(stdout, ", \"received\": %llu, \"lost\": %llu, \"abandoned\": %llu, \"duplicates\": %lu, "
+			                "\"out_of_order\": %lu, \"max_reorder\": %lu, \"mean_reorder\": %f, \"corrupted\": %lu, "
+			                "\"too_old\": %lu",
+			        s->received, s->pr ? 0 : missing, s->pr ? missing : 0,
+			        s->duplicates, s->out_of_order, s->max_reorder,
+			        s->out_of_order > 0 ? (double)s->total_reorder / s->out_of_order : 0.0,
+			        s->corrupted, s->too_old);
+		}
+		if (rec->has_setup) {
+			fprintf(stdout, ", \"failures\": %lu", rec->failures);
+			if (rec->process_memory >= 0.0) {
+				fprintf(stdout, ", \"process_bytes_per_assoc\": %f, \"system_bytes_per_assoc\": %f",
+				        rec->process_memory, rec->system_memory);
+			}
+		}
+		if ((c = rec->cost) != NULL) {
+			fprintf(stdout, ", \"cpu\": {\"user_s\": %f, \"system_s\": %f",
+			        c->user.tv_sec + c->user.tv_usec / 1000000.0,
+			        c->system.tv_sec + c->system.tv_usec / 1000000.0);
+			for (i = 0; i < NUMBER_OF_COST_COUNTERS; i++) {
+				if (!(c->missing & (1U << i))) {
+					fprintf(stdout, ", \"%s\": %llu", cost_counter_names[i], (unsigned long long)c->counters[i]);
+				}
+			}
+			fprintf(stdout, "}");
+		}
+		if (rec->enqueued_seconds > 0.0) {
+			fprintf(stdout, ", \"enqueued_seconds\": %f, \"enqueued_byte_rate\": %f",
+			        rec->enqueued_seconds, (double)rec->bytes / rec->enqueued_seconds);
+		}
+		if (rec->abandoned != NULL) {
+			fprintf(stdout, ", \"pr_abandoned_unsent\": %llu, \"pr_abandoned_sent\": %llu",
+			        (unsigned long long)rec->abandoned->unsent, (unsigned long long)rec->abandoned->sent);
+		}
+		if (rec->user_messages > 0) {
+			fprintf(stdout, ", \"user_messages\": %lu", rec->user_messages);
+		}
+		if (rec->peak_memory > 0.0) {
+			fprintf(stdout, ", \"peak_memory\": %.0f", rec->peak_memory);
+		}
+		if (rec->has_auth) {
+			fprintf(stdout, ", \"auth_data\": %s", rec->auth_data ? "true" : "false");
+		}
+		if (rec->has_associations) {
+			fprintf(stdout, ", \"associations\": %u", rec->associations);
+		}
+		fprintf(stdout, "}\n");
+	}
+	fflush(stdout);
+	funlockfile(stdout);
+}
+
+/*
+ * Per-stream results of a connection: the counters kept with -z and the
+ * verification results kept with -i. Messages missing below the highest
+ * sequence number received count as abandoned if the sender used PR-SCTP,
+ * and as lost otherwise. Jain's fairness index summarizes how evenly the
+ * bytes were spread over the streams used.
+ */
+static void print_streams(const struct connection *conn, double seconds)
+{
+	const struct verifier *v;
+	const struct stream_stats *s;
+	const struct stream_counters *c;
+	struct record rec;
+	unsigned long long missing;
+	unsigned int sid, nr_streams, used;
+	double sum, sum_of_squares;
+	char prefix[32];
+
+	v = conn->verifier;
+	nr_streams = conn->nr_streams;
+	if (verify && v != NULL && v->nr_streams > nr_streams) {
+		nr_streams = v->nr_streams;
+	}
+	used = 0;
+	sum = 0.0;
+	sum_of_squares = 0.0;
+	for (sid = 0; sid < nr_streams; sid++) {
+		c = (sid < conn->nr_streams) ? &conn->streams[sid] : NULL;
+		s = (verify && v != NULL && sid < v->nr_streams) ? &v->streams[sid] : NULL;
+		if (c != NULL && c->messages == 0 && c->bytes == 0) {
+			c = NULL;
+		}
+		if (s != NULL && s->expected == 0 && s->too_old == 0 && s->duplicates == 0 && s->corrupted == 0) {
+			s = NULL;
+		}
+		if (c == NULL && s == NULL) {
+			continue;
+		}
+		if (c != NULL) {
+			used++;
+			sum += (double)c->bytes;
+			sum_of_squares += (double)c->bytes * (double)c->bytes;
+		}
+		if (output_format != OUTPUT_TEXT) {
+			memset(&rec, 0, sizeof(rec));
+			rec.side = "receiver";
+			rec.type = "stream";
+			rec.assoc_id = (long long)conn->assoc_id;
+			rec.has_stream = 1;
+			rec.stream = sid;
+			if (c != NULL) {
+				rec.bytes = c->bytes;
+				rec.messages = c->messages;
+				rec.seconds = seconds;
+				rec.latency = one_way_latency ? &c->latency : NULL;
+			}
+			rec.verification = s;
+			print_record(&rec);
+			continue;
+		}
+		if (c != NULL) {
+			fprintf(stdout, "Stream %u: %lu messages, %llu bytes, %f B/s.\n",
+			        sid, c->messages, c->bytes, (seconds > 0.0) ? (double)c->bytes / seconds : 0.0);
+			if (one_way_latency) {
+				snprintf(prefix, sizeof(prefix), "Stream %u: ", sid);
+				print_histogram(prefix, "One-way latency", &c->latency);
+			}
+		}
+		if (s != NULL) {
+			missing = stream_missing(s);
+			fprintf(stdout, "Stream %u: %llu received, %llu lost, %llu abandoned, %lu duplicated, %lu corrupted, "
+			                "%lu out of order (reorder distance max %lu, mean %f), %lu too old to be checked.\n",
+			        sid, s->received, s->pr ? 0 : missing, s->pr ? missing : 0,
+			        s->duplicates, s->corrupted, s->out_of_order, s->max_reorder,
+			        s->out_of_order > 0 ? (double)s->total_reorder / s->out_of_order : 0.0, s->too_old);
+		}
+	}
+	if (output_format == OUTPUT_TEXT) {
+		if (used > 1 && sum_of_squares > 0.0) {
+			fprintf(stdout, "Fairness index over %u streams: %f.\n", used, sum * sum / (used * sum_of_squares));
+		}
+		if (verify && v != NULL && v->invalid > 0) {
+			fprintf(stdout, "%lu messages without a valid header.\n", v->invalid);
+		}
+	}
+	fflush(stdout);
+}
+
+/*
+ * Transport statistics: association status, the state of every path and,
+ * where the stack provides them, the association counters. The counters
+ * returned by SCTP_GET_ASSOC_STATS are cumulative, except the maximum
+ * RTO, which covers the time since the previous query.
+ */
+static void sample_transport(int fd, sctp_assoc_t assoc_id, struct transport_sample *s)
+{
+	struct sctp_status status;
+	struct sctp_paddrinfo pinfo;
+#if defined(SCTP_GET_ASSOC_STATS)
+	struct sctp_assoc_stats stats;
+#endif
+	struct sockaddr *addrs, *addr;
+	socklen_t len;
+	int n, j;
+
+	memset(s, 0, sizeof(struct transport_sample));
+	gettimeofday(&s->time, NULL);
+	memset(&status, 0, sizeof(status));
+	status.sstat_assoc_id = assoc_id;
+	len = (socklen_t)sizeof(status);
+	if (sctp_opt_info(fd, assoc_id, SCTP_STATUS, &status, &len) < 0) {
+		return;
+	}
+	s->valid = 1;
+	s->state = status.sstat_state;
+	s->rwnd = status.sstat_rwnd;
+	s->unacked = status.sstat_unackdata;
+	s->pending = status.sstat_penddata;
+#if defined(SCTP_GET_ASSOC_STATS)
+	memset(&stats, 0, sizeof(stats));
+	stats.sas_assoc_id = assoc_id;
+	len = (socklen_t)sizeof(stats);
+	if (sctp_opt_info(fd, assoc_id, SCTP_GET_ASSOC_STATS, &stats, &len) == 0) {
+		s->have_stats = 1;
+		s->rtx_chunks = stats.sas_rtxchunks;
+		s->gap_acks = stats.sas_gapcnt;
+		s->out_of_seq_tsns = stats.sas_outofseqtsns;
+		s->isacks = stats.sas_isacks;
+		s->osacks = stats.sas_osacks;
+		s->max_rto = stats.sas_maxrto;
+	}
+#endif
+	if ((n = sctp_getpaddrs(fd, assoc_id, &addrs)) <= 0) {
+		return;
+	}
+	addr = addrs;
+	for (j = 0; j < n && s->nr_paths < MAX_PATHS; j++) {
+		memset(&pinfo, 0, sizeof(pinfo));
+		pinfo.spinfo_assoc_id = assoc_id;
+		if (addr->sa_family == AF_INET) {
+			memcpy(&pinfo.spinfo_address, addr, sizeof(struct sockaddr_in));
+			inet_ntop(AF_INET, &((struct sockaddr_in *)addr)->sin_addr, s->paths[s->nr_paths].address, INET6_ADDRSTRLEN);
+			addr = (struct sockaddr *)((char *)addr + sizeof(struct sockaddr_in));
+		} else {
+			memcpy(&pinfo.spinfo_address, addr, sizeof(struct sockaddr_in6));
+			inet_ntop(AF_INET6, &((struct sockaddr_in6 *)addr)->sin6_addr, s->paths[s->nr_paths].address, INET6_ADDRSTRLEN);
+			addr = (struct sockaddr *)((char *)addr + sizeof(struct sockaddr_in6));
+		}
+		len = (socklen_t)sizeof(pinfo);
+		if (sctp_opt_info(fd, assoc_id, SCTP_GET_PEER_ADDR_INFO, &pinfo, &len) < 0) {
+			continue;
+		}
+		s->paths[s->nr_paths].state = pinfo.spinfo_state;
+		s->paths[s->nr_paths].cwnd = pinfo.spinfo_cwnd;
+		s->paths[s->nr_paths].srtt = pinfo.spinfo_srtt;
+		s->paths[s->nr_paths].rto = pinfo.spinfo_rto;
+		s->paths[s->nr_paths].mtu = pinfo.spinfo_mtu;
+		s->nr_paths++;
+	}
+	sctp_freepaddrs(addrs);
+}
+
+static void print_transport_csv_header(FILE *file)
+{
+	fprintf(file, "timestamp,side,type,assoc_id,state,rwnd,unacked,pending,rtx_chunks,gap_acks,out_of_seq_tsns,isacks,osacks,max_rto_ms,"
+	              "path,path_state,cwnd,srtt_ms,rto_ms,mtu\n");
+	fflush(file);
+}
+
+/* One CSV line per path, each repeating the association wide values. */
+static void print_transport_csv(FILE *file, const char *side, long long assoc_id, const struct transport_sample *s)
+{
+	unsigned int j;
+
+	flockfile(file);
+	for (j = 0; j < s->nr_paths; j++) {
+		fprintf(file, "%f,%s,transport,%lld,%d,%u,%u,%u,%llu,%llu,%llu,%llu,%llu,%llu,%s,%d,%u,%u,%u,%u\n",
+		        s->time.tv_sec + (double)s->time.tv_usec/1000000.0, side, assoc_id,
+		        s->state, s->rwnd, s->unacked, s->pending,
+		        (unsigned long long)s->rtx_chunks, (unsigned long long)s->gap_acks,
+		        (unsigned long long)s->out_of_seq_tsns, (unsigned long long)s->isacks,
+		        (unsigned long long)s->osacks, (unsigned long long)s->max_rto,
+		        s->paths[j].address, s->paths[j].state, s->paths[j].cwnd,
+		        s->paths[j].srtt, s->paths[j].rto, s->paths[j].mtu);
+	}
+	fflush(file);
+	funlockfile(file);
+}
+
+static void report_transport(int fd, sctp_assoc_t assoc_id, const char *side, long long id)
+{
+	struct transport_sample s;
+	unsigned int j;
+
+	sample_transport(fd, assoc_id, &s);
+	if (!s.valid) {
+		return;
+	}
+	if (transport_file != NULL) {
+		print_transport_csv(transport_file, side, id, &s);
+	}
+	switch (output_format) {
+	case OUTPUT_CSV:
+		/* Keep stdout to one kind of row when a separate file is written. */
+		if (transport_file == NULL) {
+			print_transport_csv(stdout, side, id, &s);
+		}
+		break;
+	case OUTPUT_JSON:
+		flockfile(stdout);
+		fprintf(stdout, "{\"timestamp\": %f, \"side\": \"%s\", \"type\": \"transport\", \"assoc_id\": %lld, "
+		                "\"state\": %d, \"rwnd\": %u, \"unacked\": %u, \"pending\": %u",
+		        s.time.tv_sec + (double)s.time.tv_usec/1000000.0, side, id,
+		        s.state, s.rwnd, s.unacked, s.pending);
+		if (s.have_stats) {
+			fprintf(stdout, ", \"rtx_chunks\": %llu, \"gap_acks\": %llu, \"out_of_seq_tsns\": %llu, "
+			                "\"isacks\": %llu, \"osacks\": %llu, \"max_rto_ms\": %llu",
+			        (unsigned long long)s.rtx_chunks, (unsigned long long)s.gap_acks,
+			        (unsigned long long)s.out_of_seq_tsns, (unsigned long long)s.isacks,
+			        (unsigned long long)s.osacks, (unsigned long long)s.max_rto);
+		}
+		fprintf(stdout, ", \"paths\": [");
+		for (j = 0; j < s.nr_paths; j++) {
+			fprintf(stdout, "%s{\"address\": \"%s\", \"state\": %d, \"cwnd\": %u, \"srtt_ms\": %u, \"rto_ms\": %u, \"mtu\": %u}",
+			        j > 0 ? ", " : "", s.paths[j].address, s.paths[j].state,
+			        s.paths[j].cwnd, s.paths[j].srtt, s.paths[j].rto, s.paths[j].mtu);
+		}
+		fprintf(stdout, "]}\n");
+		fflush(stdout);
+		funlockfile(stdout);
+		break;
+	default:
+		flockfile(stdout);
+		fprintf(stdout, "transport: state %d, rwnd %u, unacked %u, pending %u",
+		        s.state, s.rwnd, s.unacked, s.pending);
+		if (s.have_stats) {
+			fprintf(stdout, ", rtx chunks %llu, gap acks %llu, out of seq TSNs %llu, SACKs in/out %llu/%llu, max RTO %llu ms",
+			        (unsigned long long)s.rtx_chunks, (unsigned long long)s.gap_acks,
+			        (unsigned long long)s.out_of_seq_tsns, (unsigned long long)s.isacks,
+			        (unsigned long long)s.osacks, (unsigned long long)s.max_rto);
+		}
+		fprintf(stdout, "\n");
+		for (j = 0; j < s.nr_paths; j++) {
+			fprintf(stdout, "path %s: state %d, cwnd %u, srtt %u ms, rto %u ms, mtu %u\n",
+			        s.paths[j].address, s.paths[j].state,
+			        s.paths[j].cwnd, s.paths[j].srtt, s.paths[j].rto, s.paths[j].mtu);
+		}
+		fflush(stdout);
+		funlockfile(stdout);
+		break;
+	}
+}
+
+static void pin_thread(int cpu)
+{
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+#if defined(__FreeBSD__)
+	cpuset_t cpuset;
+#else
+	cpu_set_t cpuset;
+#endif
+	int error;
+
+	if (cpu < 0) {
+		return;
+	}
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	if ((error = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset)) != 0) {
+		fprintf(stderr, "pthread_setaffinity_np: %s\n", strerror(error));
+	}
+#endif
+}
+
+static void connection_init(struct connection *conn, int fd)
+{
+	struct sctp_status status;
+	socklen_t len;
+
+	memset(conn, 0, sizeof(struct connection));
+	conn->fd = fd;
+	if (fd >= 0 && (output_format != OUTPUT_TEXT || slots != NULL)) {
+		memset(&status, 0, sizeof(status));
+		len = (socklen_t)sizeof(status);
+		if (sctp_opt_info(fd, 0, SCTP_STATUS, &status, &len) == 0) {
+			conn->assoc_id = status.sstat_assoc_id;
+		}
+	}
+}
+
+/* Returns the number of incoming streams negotiated, all possible ones if unknown. */
+static unsigned int connection_instreams(const struct connection *conn)
+{
+	struct sctp_status status;
+	socklen_t len;
+	int result;
+
+	memset(&status, 0, sizeof(status));
+	len = (socklen_t)sizeof(status);
+	if (conn->fd >= 0) {
+		result = sctp_opt_info(conn->fd, 0, SCTP_STATUS, &status, &len);
+	} else {
+		result = sctp_opt_info(one_to_many_fd, conn->assoc_id, SCTP_STATUS, &status, &len);
+	}
+	if (result < 0 || status.sstat_instrms == 0) {
+		return 0x10000;
+	}
+	return status.sstat_instrms;
+}
+
+static void send_response(struct connection *conn, struct sctp_sndrcvinfo *sinfo)
+{
+	uint32_t flags;
+
+	if (conn->response == NULL) {
+		conn->response = malloc(response_length);
+		memset(conn->response, 'B', response_length);
+	}
+	if (response_length >= (int)sizeof(uint64_t)) {
+		memcpy(conn->response, conn->request_head, sizeof(uint64_t));
+	}
+	flags = send_flags | (sinfo->sinfo_flags & SCTP_UNORDERED);
+	if (sctp_sendmsg(conn->fd, conn->response, response_length, NULL, 0, sinfo->sinfo_ppid, flags, sinfo->sinfo_stream, timetolive, 0) < 0) {
+		perror("sctp_sendmsg");
+	}
+}
+
+static union connection_slot *claim_slot(long long assoc_id)
+{
+	union connection_slot *slot;
+	unsigned int i;
+
+	slot = NULL;
+	pthread_mutex_lock(&slots_mutex);
+	for (i = 0; i < MAX_CONNECTION_SLOTS; i++) {
+		if (!slots[i].c.used) {
+			slot = &slots[i];
+			slot->c.bytes = 0;
+			slot->c.messages = 0;
+			slot->c.assoc_id = assoc_id;
+			slot->c.generation++;
+			slot->c.used = 1;
+			break;
+		}
+	}
+	if (slot == NULL) {
+		untracked++;
+	}
+	pthread_mutex_unlock(&slots_mutex);
+	return slot;
+}
+
+/*
+ * The counters of closed connections stay in the totals, including those
+ * of connections which got no slot.
+ */
+static void release_slot(struct connection *conn)
+{
+	pthread_mutex_lock(&slots_mutex);
+	closed_bytes += conn->sum;
+	closed_messages += conn->messages;
+	if (conn->slot != NULL) {
+		conn->slot->c.used = 0;
+	} else {
+		untracked--;
+	}
+	pthread_mutex_unlock(&slots_mutex);
+	conn->slot = NULL;
+}
+
+/*
+ * The byte counter is written with plain stores, which can tear on 32 bit
+ * targets, so it is read until two reads agree. A writer preempted between
+ * the two halves can still be seen, which only skews a single interval.
+ */
+static unsigned long long slot_bytes(const union connection_slot *slot)
+{
+	unsigned long long bytes;
+
+	do {
+		bytes = slot->c.bytes;
+	} while (bytes != slot->c.bytes);
+	return bytes;
+}
+
+static struct stream_counters *connection_stream(struct connection *conn, uint16_t sid)
+{
+	struct stream_counters *streams;
+
+	if (sid >= conn->nr_streams) {
+		if ((streams = realloc(conn->streams, (sid + 1) * sizeof(struct stream_counters))) == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+		conn->streams = streams;
+		memset(conn->streams + conn->nr_streams, 0, (sid + 1 - conn->nr_streams) * sizeof(struct stream_counters));
+		conn->nr_streams = sid + 1;
+	}
+	return &conn->streams[sid];
+}
+
+/* Accounts a message, or a message unpacked from a coalesced one, received completely. */
+static void message_received(struct connection *conn, struct stream_counters *stream)
+{
+	int64_t latency;
+
+	latency = stamp_messages ? verifier_complete(conn->verifier) : -1;
+	if (stream != NULL) {
+		stream->messages++;
+		if (latency >= 0) {
+			histogram_add(&stream->latency, (uint64_t)latency);
+		}
+	}
+	conn->messages++;
+}
+
+/*
+ * Unpacks the messages of a coalesced user message, which may arrive in
+ * several pieces. Each message is preceded by its length, encoded in
+ * groups of 7 bits, least significant first, with the high bit set on
+ * all but the last byte.
+ */
+static void connection_unpack(struct connection *conn, const char *buf, size_t n, struct stream_counters *stream)
+{
+	size_t part;
+	unsigned char byte;
+
+	part = (conn->frame_skip < n) ? conn->frame_skip : n;
+	conn->frame_skip -= part;
+	buf += part;
+	n -= part;
+	while (n > 0) {
+		if (conn->frame_remaining == 0) {
+			byte = (unsigned char)*buf++;
+			n--;
+			conn->frame_length |= (uint32_t)(byte & 0x7f) << conn->frame_shift;
+			conn->frame_shift += 7;
+			if ((byte & 0x80) == 0 || conn->frame_shift > 28) {
+				conn->frame_remaining = conn->frame_length;
+				conn->frame_length = 0;
+				conn->frame_shift = 0;
+				if (conn->first_length == 0) {
+					conn->first_length = conn->frame_remaining;
+				}
+			}
+			continue;
+		}
+		part = (conn->frame_remaining < n) ? conn->frame_remaining : n;
+		if (stamp_messages) {
+			verifier_update(conn->verifier, buf, part);
+		}
+		buf += part;
+		n -= part;
+		conn->frame_remaining -= part;
+		if (conn->frame_remaining == 0) {
+			message_received(conn, stream);
+		}
+	}
+}
+
+static void connection_received(struct connection *conn, char *buf, ssize_t n, int flags, struct sctp_sndrcvinfo *sinfo)
+{
+	struct stream_counters *stream;
+	struct timeval now, diff_time;
+	double seconds;
+	uint32_t magic;
+
+	if (conn->recv_calls++ == 0) {
+		gettimeofday(&conn->start_time, NULL);
+		if (round_duration > 0) {
+			gettimeofday(&conn->round_start, NULL);
+			conn->round = report_round;
+		}
+		if (slots != NULL) {
+			conn->slot = claim_slot((long long)conn->assoc_id);
+		}
+	}
+	if (flags & MSG_NOTIFICATION) {
+		conn->notifications++;
+	} else {
+		if (very_verbose) {
+			printf("%s message of length %6zd, PPID = 0x%08x, SID = 0x%04x, SSN = 0x%04x, TSN = 0x%08x, %s.\n",
+			       flags & MSG_EOR ? "Final" : "Partial",
+			       n,
+			       ntohl(sinfo->sinfo_ppid),
+			       sinfo->sinfo_stream,
+			       sinfo->sinfo_ssn,
+			       sinfo->sinfo_tsn,
+			       sinfo->sinfo_flags & SCTP_UNORDERED ? "unordered" : "ordered");
+		}
+		conn->sum += n;
+		if (!conn->in_message) {
+			if (response_length > 0) {
+				memcpy(conn->request_head, buf, n < (ssize_t)sizeof(uint64_t) ? (size_t)n : sizeof(uint64_t));
+			}
+			if (stamp_messages && conn->verifier == NULL) {
+				if ((conn->verifier = calloc(1, sizeof(struct verifier))) == NULL) {
+					perror("calloc");
+					exit(1);
+				}
+				conn->verifier->max_streams = connection_instreams(conn);
+			}
+			/* Coalesced user messages carry their own PPID and start with a marker. */
+			magic = htonl(COALESCE_MAGIC);
+			conn->coalesced = (sinfo->sinfo_ppid == htonl(COALESCE_PPID) &&
+			                   n >= COALESCE_HEADER_SIZE && memcmp(buf, &magic, COALESCE_HEADER_SIZE) == 0);
+			conn->frame_skip = COALESCE_HEADER_SIZE;
+			conn->in_message = 1;
+			if (piece_size > 0) {
+				if (conn->delivery == NULL) {
+					conn->delivery = calloc(1, sizeof(struct histogram));
+				}
+				conn->message_start = now_ns();
+			}
+		}
+		stream = per_stream ? connection_stream(conn, sinfo->sinfo_stream) : NULL;
+		if (stream != NULL) {
+			stream->bytes += n;
+		}
+		if (conn->coalesced) {
+			connection_unpack(conn, buf, (size_t)n, stream);
+		} else if (stamp_messages) {
+			verifier_update(conn->verifier, buf, n);
+		}
+		if (conn->delivery != NULL) {
+			/* The time from the first to the last piece of a message read. */
+			if (flags & MSG_EOR) {
+				histogram_add(conn->delivery, now_ns() - conn->message_start);
+			} else {
+				conn->partial_reads++;
+			}
+		}
+		if (flags & MSG_EOR) {
+			if (response_length > 0) {
+				send_response(conn, sinfo);
+			}
+			if (conn->coalesced) {
+				conn->user_messages++;
+				/* A truncated message is not counted. */
+				conn->frame_remaining = 0;
+				conn->frame_length = 0;
+				conn->frame_shift = 0;
+			} else {
+				message_received(conn, stream);
+				if (conn->first_length == 0)
+					conn->first_length = conn->sum;
+			}
+			conn->in_message = 0;
+		}
+	}
+	if (conn->slot != NULL) {
+		conn->slot->c.bytes = conn->sum;
+		conn->slot->c.messages = conn->messages;
+	}
+	/* The reporter, or the sending side of the duplex mode, counts the rounds. */
+	if (round_duration > 0 && conn->round != report_round) {
+		gettimeofday(&now, NULL);
+		timersub(&now, &conn->round_start, &diff_time);
+		seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000.0;
+		if (output_format == OUTPUT_TEXT) {
+			flockfile(stdout);
+			fprintf(stdout, "throughput for the last %f seconds: %f B/s\n", seconds, (double)(conn->sum - conn->round_sum) / seconds);
+			if (one_way_latency && conn->verifier != NULL) {
+				print_histogram("", "One-way latency", &conn->verifier->round_latency);
+			}
+			funlockfile(stdout);
+		} else {
+			struct record rec;
+
+			memset(&rec, 0, sizeof(rec));
+			rec.side = "receiver";
+			rec.type = "interval";
+			if (one_way_latency && conn->verifier != NULL) {
+				rec.latency = &conn->verifier->round_latency;
+			}
+			rec.assoc_id = (long long)conn->assoc_id;
+			rec.bytes = conn->sum - conn->round_sum;
+			rec.messages = conn->messages - conn->round_messages;
+			rec.recv_calls = conn->recv_calls - conn->round_recv_calls;
+			rec.notifications = conn->notifications - conn->round_notifications;
+			rec.seconds = seconds;
+			print_record(&rec);
+		}
+
+		if (sample_transport_stats) {
+			if (conn->fd >= 0) {
+				report_transport(conn->fd, 0, "receiver", (long long)conn->assoc_id);
+			} else {
+				report_transport(one_to_many_fd, conn->assoc_id, "receiver", (long long)conn->assoc_id);
+			}
+		}
+
+		if (conn->verifier != NULL) {
+			memset(&conn->verifier->round_latency, 0, sizeof(struct histogram));
+		}
+		conn->round_sum = conn->sum;
+		conn->round_messages = conn->messages;
+		conn->round_recv_calls = conn->recv_calls;
+		conn->round_notifications = conn->notifications;
+		conn->round_start = now;
+		conn->round = report_round;
+	}
+}
+
+static void connection_finish(struct connection *conn)
+{
+	struct timeval now, diff_time;
+	double seconds;
+
+	gettimeofday(&now, NULL);
+	if (conn->recv_calls == 0) {
+		conn->start_time = now;
+	}
+	timersub(&now, &conn->start_time, &diff_time);
+	seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000.0;
+	if (output_format == OUTPUT_TEXT) {
+		fprintf(stdout, "%u, %lu, %lu, %lu, %llu, %f, %f\n",
+		        conn->first_length, conn->messages, conn->recv_calls, conn->notifications, conn->sum, seconds, (double)conn->sum / seconds);
+		if (conn->user_messages > 0) {
+			fprintf(stdout, "%lu messages were unpacked from %lu coalesced user messages, %f messages/sec.\n",
+			        conn->messages, conn->user_messages, (double)conn->messages / seconds);
+		}
+		if (conn->delivery != NULL) {
+			fprintf(stdout, "%lu reads returned part of a message (partial delivery point %u bytes), "
+			        "peak resident memory was %.0f bytes.\n",
+			        conn->partial_reads, piece_size, peak_memory());
+			print_histogram("", "Message delivery", conn->delivery);
+		}
+		if (one_way_latency && conn->verifier != NULL) {
+			print_histogram("", "One-way latency", &conn->verifier->latency);
+		}
+		if (conn->cost != NULL) {
+			print_cost("", conn->cost);
+		}
+		fflush(stdout);
+	} else {
+		struct record rec;
+
+		memset(&rec, 0, sizeof(rec));
+		rec.side = "receiver";
+		rec.type = "result";
+		rec.assoc_id = (long long)conn->assoc_id;
+		if (one_way_latency && conn->verifier != NULL) {
+			rec.latency = &conn->verifier->latency;
+		}
+		rec.bytes = conn->sum;
+		rec.messages = conn->messages;
+		rec.recv_calls = conn->recv_calls;
+		rec.notifications = conn->notifications;
+		rec.seconds = seconds;
+		rec.cost = conn->cost;
+		rec.user_messages = conn->user_messages;
+		if (conn->delivery != NULL) {
+			if (rec.latency == NULL) {
+				rec.latency = conn->delivery;
+			}
+			rec.peak_memory = peak_memory();
+		}
+		print_record(&rec);
+	}
+	print_streams(conn, seconds);
+	if (conn->fd >= 0) {
+		close_socket(conn->fd);
+	}
+	free(conn->response);
+	free(conn->streams);
+	free(conn->cost);
+	free(conn->delivery);
+	if (slots != NULL && conn->recv_calls > 0) {
+		release_slot(conn);
+	}
+	if (conn->verifier != NULL) {
+		free(conn->verifier->streams);
+		free(conn->verifier);
+	}
+}
+
+/*
+ * Receive side counterpart of the send engines. A receiver owns the receive
+ * buffers of one thread; a read returns one or, with recvmmsg(), several
+ * messages. With an adaptive buffer size, the buffers are doubled whenever
+ * a read filled them without completing a message.
+ */
+static void receiver_setup_buffers(struct receiver *r, size_t buffer_size)
+{
+	unsigned int j;
+
+	r->buffer_size = buffer_size;
+	free(r->buffers);
+	r->buffers = malloc(r->slots * buffer_size);
+	for (j = 0; j < r->slots; j++) {
+		r->results[j].buf = r->buffers + j * buffer_size;
+#if defined(SCTP_RCVINFO)
+		r->iovs[j].iov_base = r->results[j].buf;
+		r->iovs[j].iov_len = buffer_size;
+#endif
+	}
+}
+
+static void receiver_init(struct receiver *r)
+{
+#if defined(SCTP_RCVINFO)
+	struct msghdr *msg;
+	unsigned int j;
+#endif
+
+	memset(r, 0, sizeof(struct receiver));
+#if defined(HAVE_RECVMMSG)
+	r->slots = (engine == 2) ? batch_size : 1;
+#else
+	r->slots = 1;
+#endif
+	r->results = calloc(r->slots, sizeof(struct recv_result));
+#if defined(SCTP_RCVINFO)
+	r->iovs = calloc(r->slots, sizeof(struct iovec));
+	r->control_len = want_rcvinfo ? CMSG_SPACE(sizeof(struct sctp_rcvinfo)) : 0;
+	r->control = (r->control_len > 0) ? calloc(r->slots, r->control_len) : NULL;
+#if defined(HAVE_RECVMMSG)
+	r->msgs = calloc(r->slots, sizeof(struct mmsghdr));
+#else
+	r->msgs = calloc(r->slots, sizeof(struct msghdr));
+#endif
+	for (j = 0; j < r->slots; j++) {
+#if defined(HAVE_RECVMMSG)
+		msg = &r->msgs[j].msg_hdr;
+#else
+		msg = &r->msgs[j];
+#endif
+		msg->msg_iov = &r->iovs[j];
+		msg->msg_iovlen = 1;
+	}
+#endif
+	receiver_setup_buffers(r, (recv_buffer_size > 0) ? recv_buffer_size : BUFFERSIZE);
+}
+
+static void receiver_free(struct receiver *r)
+{
+#if defined(SCTP_RCVINFO)
+	free(r->msgs);
+	free(r->control);
+	free(r->iovs);
+#endif
+	free(r->results);
+	free(r->buffers);
+}
+
+#if defined(SCTP_RCVINFO)
+static void receiver_parse(struct recv_result *result, struct msghdr *msg, ssize_t n)
+{
+	struct sctp_rcvinfo *rcvinfo;
+	struct cmsghdr *cmsg;
+
+	result->n = n;
+	result->flags = msg->msg_flags;
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level == IPPROTO_SCTP && cmsg->cmsg_type == SCTP_RCVINFO) {
+			rcvinfo = (struct sctp_rcvinfo *)CMSG_DATA(cmsg);
+			result->sinfo.sinfo_stream = rcvinfo->rcv_sid;
+			result->sinfo.sinfo_ssn = rcvinfo->rcv_ssn;
+			result->sinfo.sinfo_flags = rcvinfo->rcv_flags;
+			result->sinfo.sinfo_ppid = rcvinfo->rcv_ppid;
+			result->sinfo.sinfo_tsn = rcvinfo->rcv_tsn;
+			result->sinfo.sinfo_cumtsn = rcvinfo->rcv_cumtsn;
+			result->sinfo.sinfo_context = rcvinfo->rcv_context;
+			result->sinfo.sinfo_assoc_id = rcvinfo->rcv_assoc_id;
+		}
+	}
+}
+#endif
+
+/*
+ * Returns the number of messages read, 0 if the peer closed the association
+ * before anything was read and -1 on error. r->eof is set when the peer
+ * closed the association.
+ */
+static int receiver_read(struct receiver *r, int fd)
+{
+	struct recv_result *result;
+	socklen_t len;
+	ssize_t n;
+	int count, j;
+#if defined(SCTP_RCVINFO)
+	struct msghdr *msg;
+#endif
+
+	count = 0;
+	switch (engine) {
+#if defined(SCTP_RCVINFO)
+	case 1:
+#if defined(HAVE_RECVMMSG)
+		msg = &r->msgs[0].msg_hdr;
+#else
+		msg = &r->msgs[0];
+#endif
+		msg->msg_control = r->control;
+		msg->msg_controllen = r->control_len;
+		msg->msg_flags = 0;
+		memset(&r->results[0].sinfo, 0, sizeof(struct sctp_sndrcvinfo));
+		if ((n = recvmsg(fd, msg, 0)) < 0) {
+			return -1;
+		}
+		receiver_parse(&r->results[0], msg, n);
+		count = 1;
+		break;
+#if defined(HAVE_RECVMMSG)
+	case 2:
+		for (j = 0; j < (int)r->slots; j++) {
+			r->msgs[j].msg_hdr.msg_control = (r->control != NULL) ? r->control + j * r->control_len : NULL;
+			r->msgs[j].msg_hdr.msg_controllen = r->control_len;
+			r->msgs[j].msg_hdr.msg_flags = 0;
+			memset(&r->results[j].sinfo, 0, sizeof(struct sctp_sndrcvinfo));
+		}
+		if ((count = recvmmsg(fd, r->msgs, r->slots, MSG_WAITFORONE, NULL)) < 0) {
+			return -1;
+		}
+		for (j = 0; j < count; j++) {
+			receiver_parse(&r->results[j], &r->msgs[j].msg_hdr, r->msgs[j].msg_len);
+		}
+		break;
+#endif
+#endif
+	default:
+		result = &r->results[0];
+		result->flags = 0;
+		len = (socklen_t)0;
+		if ((result->n = sctp_recvmsg(fd, (void*)result->buf, r->buffer_size, NULL, &len, &result->sinfo, &result->flags)) < 0) {
+			return -1;
+		}
+		count = 1;
+		break;
+	}
+	for (j = 0; j < count; j++) {
+		result = &r->results[j];
+		if (result->n == 0) {
+			r->eof = 1;
+			count = j;
+			break;
+		}
+		if (recv_buffer_size == 0 &&
+		    !(result->flags & (MSG_EOR | MSG_NOTIFICATION)) &&
+		    (size_t)result->n == r->buffer_size &&
+		    r->buffer_size < MAX_RECV_BUFFERSIZE) {
+			r->grow = 1;
+		}
+	}
+	return count;
+}
+
+/* Must only be called once the results of the last read have been consumed. */
+static void receiver_adapt(struct receiver *r)
+{
+	if (r->grow) {
+		r->grow = 0;
+		receiver_setup_buffers(r, 2 * r->buffer_size);
+	}
+}
+
+static void thread_cost_begin(struct thread_cost *t, struct connection *conn)
+{
+	if (!cpu_cost || conn->cost_counted) {
+		return;
+	}
+	conn->cost_counted = 1;
+	if (t->active++ == 0) {
+		cost_start(&t->cost);
+		gettimeofday(&t->start_time, NULL);
+		t->associations = 0;
+		t->bytes = 0;
+		t->messages = 0;
+		t->calls = 0;
+	}
+	t->associations++;
+}
+
+/* Reports the cost of the thread once it has no association left. */
+static void thread_cost_end(struct thread_cost *t, const struct connection *conn, long long thread)
+{
+	struct timeval now, diff_time;
+	double seconds;
+
+	if (!conn->cost_counted) {
+		return;
+	}
+	t->bytes += conn->sum;
+	t->messages += conn->messages;
+	t->calls += conn->recv_calls;
+	if (--t->active > 0) {
+		return;
+	}
+	cost_stop(&t->cost, t->bytes, t->messages, t->calls);
+	gettimeofday(&now, NULL);
+	timersub(&now, &t->start_time, &diff_time);
+	seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000.0;
+	if (output_format == OUTPUT_TEXT) {
+		flockfile(stdout);
+		if (thread < 0) {
+			fprintf(stdout, "The receiving thread served %lu associations in %f seconds.\n", t->associations, seconds);
+		} else {
+			fprintf(stdout, "Receive worker %lld served %lu associations in %f seconds.\n", thread, t->associations, seconds);
+		}
+		print_cost("", &t->cost);
+		funlockfile(stdout);
+	} else {
+		struct record rec;
+
+		memset(&rec, 0, sizeof(rec));
+		rec.side = "receiver";
+		rec.type = "thread";
+		rec.assoc_id = thread;
+		rec.bytes = t->bytes;
+		rec.messages = t->messages;
+		rec.recv_calls = t->calls;
+		rec.seconds = seconds;
+		rec.cost = &t->cost;
+		print_record(&rec);
+	}
+}
+
+static void receive_until_eof(struct connection *conn)
+{
+	struct receiver r;
+	int count, j;
+
+	receiver_init(&r);
+	if (cpu_cost) {
+		conn->cost = malloc(sizeof(struct cpu_cost));
+		cost_start(conn->cost);
+	}
+	count = 0;
+	while (!r.eof && (count = receiver_read(&r, conn->fd)) > 0) {
+		for (j = 0; j < count; j++) {
+			connection_received(conn, r.results[j].buf, r.results[j].n, r.results[j].flags, &r.results[j].sinfo);
+		}
+		receiver_adapt(&r);
+	}
+	if (count < 0)
+		perror("recvmsg");
+	if (conn->cost != NULL) {
+		cost_stop(conn->cost, conn->sum, conn->messages, conn->recv_calls);
+	}
+	receiver_free(&r);
+}
+
+static void set_sender_options(int fd);
+static void* duplex_send(void *arg);
+static void print_sender_result(const char *prefix, long long assoc_id, struct sender_info *info);
+
+static void* handle_connection(void *arg)
+{
+	struct connection conn;
+	struct sender_info *info;
+	pthread_t tid;
+
+	connection_init(&conn, *(int *) arg);
+	free(arg);
+	tid = pthread_self();
+	pthread_detach(tid);
+
+	info = NULL;
+	if (duplex) {
+		info = calloc(1, sizeof(struct sender_info));
+		info->fd = conn.fd;
+		set_sender_options(conn.fd);
+		if (pthread_create(&info->tid, NULL, &duplex_send, (void *)info) != 0) {
+			perror("pthread_create");
+			free(info);
+			info = NULL;
+		}
+	}
+	receive_until_eof(&conn);
+	if (info != NULL) {
+		info->stop = 1;
+		pthread_join(info->tid, NULL);
+		print_sender_result("", (long long)conn.assoc_id, info);
+		free(info);
+	}
+	connection_finish(&conn);
+#if defined(USRSCTP)
+	loopback_count(&loopback_finished);
+#endif
+	return NULL;
+}
+
+#if defined(HAVE_SYS_EPOLL_H)
+/*
+ * Event driven receiver: a fixed pool of workers, each owning an epoll
+ * instance and a single receiver. The accepting thread hands new
+ * associations to the workers in a round robin fashion.
+ */
+static void* receive_worker(void *arg)
+{
+	struct receive_worker *worker;
+	struct epoll_event events[MAX_EVENTS];
+	struct connection *conn;
+	struct receiver r;
+	struct thread_cost cost;
+	int nfds, j, k, count, reads;
+
+	worker = (struct receive_worker *)arg;
+	pin_thread(worker->cpu);
+	receiver_init(&r);
+	memset(&cost, 0, sizeof(cost));
+	while (1) {
+		nfds = epoll_wait(worker->epfd, events, MAX_EVENTS, -1);
+		if (nfds < 0) {
+			if (errno != EINTR) {
+				perror("epoll_wait");
+			}
+			continue;
+		}
+		for (j = 0; j < nfds; j++) {
+			conn = (struct connection *)events[j].data.ptr;
+			thread_cost_begin(&cost, conn);
+			/* Bound the work per event so that one busy association can't starve the others. */
+			for (reads = 0; reads < MAX_READS_PER_EVENT; reads++) {
+				r.eof = 0;
+				count = receiver_read(&r, conn->fd);
+				for (k = 0; k < count; k++) {
+					connection_received(conn, r.results[k].buf, r.results[k].n, r.results[k].flags, &r.results[k].sinfo);
+				}
+				receiver_adapt(&r);
+				if (count > 0 && !r.eof) {
+					continue;
+				}
+				if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+					break;
+				}
+				if (count < 0) {
+					perror("recvmsg");
+				}
+				epoll_ctl(worker->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+				thread_cost_end(&cost, conn, (long long)worker->index);
+				connection_finish(conn);
+				free(conn);
+				break;
+			}
+		}
+	}
+	receiver_free(&r);
+	return NULL;
+}
+
+static struct receive_worker *start_receive_workers(unsigned int number_of_workers, int *cpus, unsigned int nr_cpus)
+{
+	struct receive_worker *workers;
+	unsigned int i;
+
+	workers = calloc(number_of_workers, sizeof(struct receive_worker));
+	for (i = 0; i < number_of_workers; i++) {
+		workers[i].index = i;
+		workers[i].cpu = (nr_cpus > 0) ? cpus[i % nr_cpus] : -1;
+		if ((workers[i].epfd = epoll_create1(0)) < 0) {
+			perror("epoll_create1");
+			exit(1);
+		}
+		if (pthread_create(&workers[i].tid, NULL, &receive_worker, (void *)&workers[i]) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	return workers;
+}
+
+static void add_to_receive_worker(struct receive_worker *worker, int fd)
+{
+	struct epoll_event event;
+	struct connection *conn;
+	int fl;
+
+	if ((fl = fcntl(fd, F_GETFL, 0)) < 0 || fcntl(fd, F_SETFL, fl | O_NONBLOCK) < 0) {
+		perror("fcntl");
+	}
+	conn = malloc(sizeof(struct connection));
+	connection_init(conn, fd);
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = conn;
+	if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+		perror("epoll_ctl");
+		close_socket(fd);
+		free(conn);
+	}
+}
+#endif
+
+static struct connection *lookup_association(sctp_assoc_t assoc_id, int create)
+{
+	struct connection *conn;
+	unsigned int bucket;
+
+	bucket = (unsigned int)assoc_id % ASSOC_TABLE_SIZE;
+	for (conn = assoc_table[bucket]; conn != NULL; conn = conn->next) {
+		if (conn->assoc_id == assoc_id) {
+			return conn;
+		}
+	}
+	if (!create) {
+		return NULL;
+	}
+	conn = malloc(sizeof(struct connection));
+	connection_init(conn, -1);
+	conn->assoc_id = assoc_id;
+	conn->next = assoc_table[bucket];
+	assoc_table[bucket] = conn;
+	return conn;
+}
+
+static void remove_association(struct connection *conn)
+{
+	struct connection **prev;
+	unsigned int bucket;
+
+	bucket = (unsigned int)conn->assoc_id % ASSOC_TABLE_SIZE;
+	for (prev = &assoc_table[bucket]; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == conn) {
+			*prev = conn->next;
+			break;
+		}
+	}
+	free(conn);
+}
+
+/* Returns the association a notification belongs to, or 0 if unknown. */
+static sctp_assoc_t notification_assoc_id(const union sctp_notification *snp)
+{
+	switch (snp->sn_header.sn_type) {
+	case SCTP_ASSOC_CHANGE:
+		return snp->sn_assoc_change.sac_assoc_id;
+	case SCTP_PEER_ADDR_CHANGE:
+		return snp->sn_paddr_change.spc_assoc_id;
+	case SCTP_REMOTE_ERROR:
+		return snp->sn_remote_error.sre_assoc_id;
+	case SCTP_SHUTDOWN_EVENT:
+		return snp->sn_shutdown_event.sse_assoc_id;
+	case SCTP_ADAPTATION_INDICATION:
+		return snp->sn_adaptation_event.sai_assoc_id;
+	case SCTP_PARTIAL_DELIVERY_EVENT:
+		return snp->sn_pdapi_event.pdapi_assoc_id;
+#if !defined(USRSCTP)
+	case SCTP_SEND_FAILED:
+		return snp->sn_send_failed.ssf_assoc_id;
+#endif
+#if defined(SCTP_SEND_FAILED_EVENT)
+	case SCTP_SEND_FAILED_EVENT:
+#if defined(LINUX) && !defined(USRSCTP)
+		return snp->sn_send_failed_event.ssf_assoc_id;
+#else
+		return snp->sn_send_failed_event.ssfe_assoc_id;
+#endif
+#endif
+#if defined(SCTP_SENDER_DRY_EVENT)
+	case SCTP_SENDER_DRY_EVENT:
+		return snp->sn_sender_dry_event.sender_dry_assoc_id;
+#endif
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Receiver for one-to-many style sockets: all associations share the
+ * listening socket and are told apart by the association identifier.
+ */
+static void receive_one_to_many(int fd)
+{
+	union sctp_notification *snp;
+	struct recv_result *result;
+	struct connection *conn;
+	struct receiver r;
+	struct thread_cost cost;
+	int count, j;
+
+	receiver_init(&r);
+	memset(&cost, 0, sizeof(cost));
+	while (1) {
+		r.eof = 0;
+		count = receiver_read(&r, fd);
+		if (count < 0 && errno != EINTR) {
+			perror("recvmsg");
+		}
+		for (j = 0; j < count; j++) {
+			result = &r.results[j];
+			if (result->flags & MSG_NOTIFICATION) {
+				snp = (union sctp_notification *)result->buf;
+				if (snp->sn_header.sn_type != SCTP_ASSOC_CHANGE) {
+					/* Other notifications are counted like on one-to-one sockets. */
+					conn = lookup_association(notification_assoc_id(snp), 0);
+					if (conn != NULL) {
+						connection_received(conn, result->buf, result->n, result->flags, &result->sinfo);
+					}
+					continue;
+				}
+				conn = lookup_association(snp->sn_assoc_change.sac_assoc_id, 1);
+				thread_cost_begin(&cost, conn);
+				connection_received(conn, result->buf, result->n, result->flags, &result->sinfo);
+				switch (snp->sn_assoc_change.sac_state) {
+				case SCTP_COMM_LOST:
+				case SCTP_SHUTDOWN_COMP:
+				case SCTP_CANT_STR_ASSOC:
+					thread_cost_end(&cost, conn, -1);
+					connection_finish(conn);
+					remove_association(conn);
+					break;
+				default:
+					break;
+				}
+			} else {
+				conn = lookup_association(result->sinfo.sinfo_assoc_id, 1);
+				thread_cost_begin(&cost, conn);
+				connection_received(conn, result->buf, result->n, result->flags, &result->sinfo);
+			}
+		}
+		receiver_adapt(&r);
+	}
+	receiver_free(&r);
+}
+
+#ifdef SCTP_AUTH_CHUNK
+/*
+ * Authentication of the chunks given by -A, with the HMAC and keys given.
+ * The keys are endpoint keys, so the associations inherit them. Key 1 is
+ * the given key, keys 2 to NUMBER_OF_AUTH_KEYS append their number to it,
+ * so both ends derive the same keys to rotate through.
+ */
+static void set_auth_options(int fd)
+{
+	struct sctp_authchunk sac;
+	struct sctp_hmacalgo *algo;
+	struct sctp_authkey *key;
+	struct sctp_authkeyid keyid;
+	unsigned int chunk_number;
+	size_t key_size;
+	uint16_t number;
+#if defined(SCTP_AUTH_SUPPORTED)
+	struct sctp_assoc_value av;
+
+	if (number_of_chunks_to_auth > 0) {
+		av.assoc_id = 0;
+		av.assoc_value = 1;
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_AUTH_SUPPORTED, (const void*)&av, (socklen_t)sizeof(struct sctp_assoc_value)) < 0) {
+			perror("setsockopt: auth supported");
+		}
+	}
+#endif
+	for (chunk_number = 0; chunk_number < number_of_chunks_to_auth; chunk_number++) {
+		sac.sauth_chunk = chunk[chunk_number];
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_AUTH_CHUNK, &sac, (socklen_t)sizeof(struct sctp_authchunk)) < 0)
+			perror("setsockopt");
+	}
+	/*
+	 * The stacks insist on SHA-1 being in the list, the peer uses the
+	 * first HMAC of it that it supports.
+	 */
+	if (hmac_ident != 0) {
+		if ((algo = malloc(sizeof(struct sctp_hmacalgo) + 2 * sizeof(uint16_t))) == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		algo->shmac_number_of_idents = 0;
+		algo->shmac_idents[algo->shmac_number_of_idents++] = hmac_ident;
+		if (hmac_ident != SCTP_AUTH_HMAC_ID_SHA1) {
+			algo->shmac_idents[algo->shmac_number_of_idents++] = SCTP_AUTH_HMAC_ID_SHA1;
+		}
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_HMAC_IDENT, algo,
+		               (socklen_t)(sizeof(struct sctp_hmacalgo) + algo->shmac_number_of_idents * sizeof(uint16_t))) < 0) {
+			perror("setsockopt: hmac ident");
+			exit(1);
+		}
+		free(algo);
+	}
+	if (auth_key_length == 0) {
+		return;
+	}
+	key_size = sizeof(struct sctp_authkey) + auth_key_length + 1;
+	key = malloc(key_size);
+	for (number = 1; number <= NUMBER_OF_AUTH_KEYS; number++) {
+		memset(key, 0, key_size);
+		key->sca_assoc_id = 0;
+		key->sca_keynumber = number;
+		key->sca_keylength = (number == 1) ? auth_key_length : auth_key_length + 1;
+		memcpy(key->sca_key, auth_key, auth_key_length);
+		key->sca_key[auth_key_length] = (uint8_t)number;
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_AUTH_KEY, key, (socklen_t)(sizeof(struct sctp_authkey) + key->sca_keylength)) < 0) {
+			perror("setsockopt: auth key");
+		}
+	}
+	free(key);
+	memset(&keyid, 0, sizeof(keyid));
+	keyid.scact_assoc_id = 0;
+	keyid.scact_keynumber = 1;
+	if (setsockopt(fd, IPPROTO_SCTP, SCTP_AUTH_ACTIVE_KEY, &keyid, (socklen_t)sizeof(struct sctp_authkeyid)) < 0) {
+		perror("setsockopt: active key");
+	}
+}
+
+/* Returns whether the peer requires DATA chunks to be authenticated, or -1. */
+static int peer_authenticates_data(int fd, sctp_assoc_t assoc_id)
+{
+	struct sctp_authchunks *chunks;
+	socklen_t len;
+	unsigned int j;
+	int result;
+
+	len = (socklen_t)(sizeof(struct sctp_authchunks) + 256);
+	chunks = calloc(1, len);
+	chunks->gauth_assoc_id = assoc_id;
+	result = -1;
+	if (getsockopt(fd, IPPROTO_SCTP, SCTP_PEER_AUTH_CHUNKS, chunks, &len) == 0) {
+		result = 0;
+		for (j = 0; j < chunks->gauth_number_of_chunks && j < 256; j++) {
+			if (chunks->gauth_chunks[j] == 0) {
+				result = 1;
+			}
+		}
+	}
+	free(chunks);
+	return result;
+}
+
+/* Makes the next key the active one on an association. */
+static void rotate_key(int fd, sctp_assoc_t assoc_id)
+{
+	struct sctp_authkeyid keyid;
+
+	memset(&keyid, 0, sizeof(keyid));
+	keyid.scact_assoc_id = assoc_id;
+	keyid.scact_keynumber = (uint16_t)(key_changes % NUMBER_OF_AUTH_KEYS + 1);
+	if (setsockopt(fd, IPPROTO_SCTP, SCTP_AUTH_ACTIVE_KEY, &keyid, (socklen_t)sizeof(struct sctp_authkeyid)) < 0) {
+		perror("setsockopt: active key");
+	}
+}
+#endif
+
+static int create_socket(int client)
+{
+	int fd, family;
+#ifdef SCTP_REMOTE_UDP_ENCAPS_PORT
+	struct sctp_udpencaps encaps;
+#endif
+#if defined(SCTP_INTERLEAVING_SUPPORTED)
+	struct sctp_assoc_value av;
+#endif
+#if defined(SCTP_EXPLICIT_EOR)
+	struct sctp_assoc_value eor;
+#endif
+	struct sctp_initmsg init;
+
+	family = ipv4only ? AF_INET : AF_INET6;
+#if defined(USRSCTP)
+	if (loopback == LOOPBACK_MEMORY) {
+		family = AF_CONN;
+	}
+#endif
+	if ((fd = socket(family, (one_to_many ? SOCK_SEQPACKET : SOCK_STREAM), IPPROTO_SCTP)) < 0)
+		perror("socket");
+
+	if (family == AF_INET6) {
+		if (ipv6only) {
+			if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, (const void*)&on, (socklen_t)sizeof(on)) < 0)
+				perror("ipv6only");
+		} else {
+			if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, (const void*)&off, (socklen_t)sizeof(off)) < 0)
+				perror("ipv6only");
+		}
+	}
+
+#ifdef SCTP_AUTH_CHUNK
+	set_auth_options(fd);
+#endif
+	if (ind.ssb_adaptation_ind > 0) {
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_ADAPTATION_LAYER, (const void*)&ind, (socklen_t)sizeof(struct sctp_setadaptation)) < 0) {
+			perror("setsockopt");
+		}
+	}
+	memset(&init, 0, sizeof(init));
+	init.sinit_num_ostreams = streams;
+	init.sinit_max_instreams = 0xffff;
+	init.sinit_max_attempts = 0;
+	init.sinit_max_init_timeo = 0;
+	if (setsockopt(fd, IPPROTO_SCTP, SCTP_INITMSG, (const void *)&init, (socklen_t)sizeof(struct sctp_initmsg)) < 0) {
+		perror("setsockopt");
+	}
+	if (!client) {
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const void*)&on, (socklen_t)sizeof(on));
+	}
+#if defined(SCTP_EXPLICIT_EOR)
+	/* Messages are sent in pieces, the last one carries SCTP_EOR. */
+	if (client && piece_size > 0) {
+		eor.assoc_id = 0;
+		eor.assoc_value = 1;
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_EXPLICIT_EOR, (const void*)&eor, (socklen_t)sizeof(struct sctp_assoc_value)) < 0) {
+			perror("setsockopt: explicit EOR");
+		}
+	}
+#endif
+#ifdef SCTP_REMOTE_UDP_ENCAPS_PORT
+	memset(&encaps, 0, sizeof(struct sctp_udpencaps));
+	encaps.sue_address.ss_family = (ipv4only ? AF_INET : AF_INET6);
+	encaps.sue_port = htons(udp_port);
+	if (setsockopt(fd, IPPROTO_SCTP, SCTP_REMOTE_UDP_ENCAPS_PORT, (const void*)&encaps, (socklen_t)sizeof(struct sctp_udpencaps)) < 0) {
+		perror("setsockopt");
+	}
+#endif
+#if defined(SCTP_INTERLEAVING_SUPPORTED)
+	if (interleave != 0) {
+		int level;
+
+		level = 2;
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_FRAGMENT_INTERLEAVE, (const void*)&level, (socklen_t)sizeof(int)) < 0) {
+			perror("setsockopt");
+		}
+		av.assoc_id = 0;
+		av.assoc_value = 1;
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_INTERLEAVING_SUPPORTED, (const void*)&av, (socklen_t)sizeof(struct sctp_assoc_value)) < 0) {
+			perror("setsockopt");
+		}
+	}
+#endif
+#if defined(USRSCTP)
+	if (loopback != LOOPBACK_NONE && client) {
+		/* The local addresses are the server's, the client is bound to its end of the loopback. */
+		if (loopback == LOOPBACK_MEMORY) {
+			union sock_union addr;
+
+			loopback_address(&addr, 0, 0);
+			if (sctp_bindx(fd, &addr.sa, 1, SCTP_BINDX_ADD_ADDR) != 0)
+				perror("bind");
+		}
+		return fd;
+	}
+#endif
+	if (nr_local_addr > 0) {
+		if (sctp_bindx(fd, (struct sockaddr *)local_addr, nr_local_addr, SCTP_BINDX_ADD_ADDR) != 0)
+			perror("bind");
+	}
+	return fd;
+}
+
+/* Ancillary data and notifications wanted on sockets data is received on. */
+#if defined(USRSCTP)
+static void set_receive_options(int fd)
+{
+	struct sctp_event event;
+
+	if (want_rcvinfo) {
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_RECVRCVINFO, (const void*)&on, (socklen_t)sizeof(on)) < 0) {
+			perror("setsockopt: SCTP_RECVRCVINFO");
+		}
+	}
+	if (one_to_many) {
+		memset(&event, 0, sizeof(event));
+		event.se_assoc_id = SCTP_FUTURE_ASSOC;
+		event.se_type = SCTP_ASSOC_CHANGE;
+		event.se_on = 1;
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_EVENT, &event, sizeof(event)) != 0) {
+			perror("set event failed");
+		}
+	}
+}
+#else
+static void set_receive_options(int fd)
+{
+	struct sctp_event_subscribe event;
+
+#if defined(SCTP_RECVRCVINFO)
+	if (engine != 0 && want_rcvinfo) {
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_RECVRCVINFO, (const void*)&on, (socklen_t)sizeof(on)) < 0) {
+			perror("setsockopt: SCTP_RECVRCVINFO");
+		}
+	}
+#endif
+	memset(&event, 0, sizeof(event));
+	event.sctp_data_io_event = (engine == 0 && want_rcvinfo);
+	if (one_to_many) {
+		event.sctp_association_event = 1;
+	}
+	if (setsockopt(fd, IPPROTO_SCTP, SCTP_EVENTS, &event, sizeof(event)) != 0) {
+		perror("set event failed");
+	}
+}
+#endif
+
+/* Options which may change between the points of a sweep. */
+static void set_sender_options(int fd)
+{
+#ifdef SCTP_NODELAY
+	/* Explicit settings, because LKSCTP does not enable it by default */
+	if (nodelay == 1) {
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_NODELAY, (char *)&on, sizeof(on)) < 0) {
+			perror("setsockopt: nodelay");
+		}
+	} else {
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_NODELAY, (char *)&off, sizeof(off)) < 0) {
+			perror("setsockopt: nodelay");
+		}
+	}
+#endif
+	if (sndbufsize)
+		if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbufsize, sizeof(int)) < 0) {
+			perror("setsockopt: sndbuf");
+		}
+}
+
+/* Parses a comma separated list of unsigned values. */
+static unsigned int parse_list(char *arg, unsigned int **values)
+{
+	char *token;
+	unsigned int n;
+
+	n = 0;
+	*values = NULL;
+	for (token = strtok(arg, ","); token != NULL; token = strtok(NULL, ",")) {
+		if ((*values = realloc(*values, (n + 1) * sizeof(unsigned int))) == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+		(*values)[n++] = (unsigned int)strtoul(token, NULL, 0);
+	}
+	return n;
+}
+
+#if defined(SCTP_STREAM_SCHEDULER)
+static int parse_stream_scheduler(char *arg)
+{
+	char *values;
+	unsigned int j;
+
+	if ((values = strchr(arg, ':')) != NULL) {
+		*values++ = '\0';
+		nr_scheduler_values = parse_list(values, &scheduler_values);
+	}
+	for (j = 0; j < sizeof(stream_schedulers) / sizeof(stream_schedulers[0]); j++) {
+		if (strcmp(arg, stream_schedulers[j].name) == 0) {
+			stream_scheduler = (int)stream_schedulers[j].value;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Selects the stream scheduler of an association and sets the values of
+ * its streams, the priority for prio and the weight for wfq.
+ */
+static void set_stream_scheduler(int fd, sctp_assoc_t assoc_id)
+{
+	struct sctp_assoc_value av;
+	struct sctp_stream_value sv;
+	unsigned int j;
+
+	if (stream_scheduler < 0) {
+		return;
+	}
+	av.assoc_id = assoc_id;
+	av.assoc_value = (uint32_t)stream_scheduler;
+	if (setsockopt(fd, IPPROTO_SCTP, SCTP_STREAM_SCHEDULER, &av, sizeof(av)) < 0) {
+		perror("setsockopt: SCTP_STREAM_SCHEDULER");
+		return;
+	}
+	for (j = 0; j < nr_scheduler_values && j < streams; j++) {
+		sv.assoc_id = assoc_id;
+		sv.stream_id = (uint16_t)j;
+		sv.stream_value = (uint16_t)scheduler_values[j];
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_STREAM_SCHEDULER_VALUE, &sv, sizeof(sv)) < 0) {
+			perror("setsockopt: SCTP_STREAM_SCHEDULER_VALUE");
+		}
+	}
+}
+#endif
+
+static int connect_socket(int fd, unsigned int addr_index, int report)
+{
+	struct sctp_assoc_value av;
+	int mysndbufsize;
+	socklen_t intlen;
+
+	if (fragpoint) {
+		av.assoc_id = 0;
+		av.assoc_value = fragpoint;
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_MAXSEG, &av, sizeof(av)) < 0) {
+			perror("setsockopt: SCTP_MAXSEG");
+		}
+	}
+
+	if (one_to_many) {
+		if (sctp_connectx(fd, &remote_addrs[addr_index].sa, 1, &assoc_ids[addr_index]) < 0) {
+			perror("sctp_connectx");
+			return -1;
+		}
+	} else {
+		if (connect(fd, &remote_addrs[addr_index].sa, remote_addr_lens[addr_index]) < 0) {
+			perror("connect");
+			return -1;
+		}
+	}
+#if defined(USRSCTP)
+	loopback_count(&loopback_opened);
+#endif
+
+	set_sender_options(fd);
+#if defined(SCTP_STREAM_SCHEDULER)
+	set_stream_scheduler(fd, one_to_many ? assoc_ids[addr_index] : 0);
+#endif
+
+	if (report) {
+		intlen = sizeof(int);
+		if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &mysndbufsize, &intlen) < 0) {
+			perror("setsockopt: sndbuf");
+		} else {
+			fprintf(stdout,"Send buffer size: %d.\n", mysndbufsize);
+		}
+	}
+	return 0;
+}
+
+/* In duplex mode the server keeps sending until the client has shut down. */
+static void send_error(struct sender_info *info, const char *s)
+{
+	if (info->stop || (duplex && errno == EPIPE)) {
+		return;
+	}
+	perror(s);
+}
+
+static unsigned int stream_weight(uint16_t sid)
+{
+	return (sid < nr_stream_weights) ? stream_weights[sid] : 1;
+}
+
+/*
+ * Picks the stream of the message after one sent on sid. Without weights
+ * the streams are used round robin, with weights by smooth weighted round
+ * robin, which interleaves the messages of the streams evenly.
+ */
+static uint16_t next_stream(uint16_t sid, long *credit)
+{
+	long total;
+	uint16_t j, best;
+
+	if (nr_stream_weights == 0) {
+		return (sid + 1 == streams) ? 0 : sid + 1;
+	}
+	total = 0;
+	best = 0;
+	for (j = 0; j < streams; j++) {
+		credit[j] += stream_weight(j);
+		total += stream_weight(j);
+		if (credit[j] > credit[best]) {
+			best = j;
+		}
+	}
+	credit[best] -= total;
+	return best;
+}
+
+static uint16_t first_stream(long *credit)
+{
+	return (nr_stream_weights == 0) ? 0 : next_stream(0, credit);
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+	uint64_t x;
+
+	x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+/* Uniformly distributed in [0, 1). */
+static double next_unit(uint64_t *state)
+{
+	return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Parses a decimal number of the trace, with an optional fraction. */
+static int trace_number(size_t *offset, double *value)
+{
+	size_t i;
+	double scale;
+	int digits;
+
+	i = *offset;
+	while (i < trace_size && (trace_data[i] == ' ' || trace_data[i] == '\t')) {
+		i++;
+	}
+	*value = 0.0;
+	digits = 0;
+	for (; i < trace_size && trace_data[i] >= '0' && trace_data[i] <= '9'; i++, digits++) {
+		*value = *value * 10.0 + (trace_data[i] - '0');
+	}
+	if (i < trace_size && trace_data[i] == '.') {
+		for (i++, scale = 0.1; i < trace_size && trace_data[i] >= '0' && trace_data[i] <= '9'; i++, digits++, scale /= 10.0) {
+			*value += (trace_data[i] - '0') * scale;
+		}
+	}
+	*offset = i;
+	return (digits > 0) ? 0 : -1;
+}
+
+/*
+ * Parses the record of the trace at *offset: the send time in seconds,
+ * the size and the stream of a message, separated by blanks. Empty lines
+ * and lines starting with # are skipped. Returns 1 for a record, 0 at
+ * the end of the trace and -1 for a malformed record.
+ */
+static int trace_record(size_t *offset, double *time, unsigned long *size, unsigned long *sid)
+{
+	size_t i;
+	double value;
+
+	i = *offset;
+	for (;;) {
+		while (i < trace_size && (trace_data[i] == ' ' || trace_data[i] == '\t' || trace_data[i] == '\r')) {
+			i++;
+		}
+		if (i == trace_size) {
+			*offset = i;
+			return 0;
+		}
+		if (trace_data[i] == '#') {
+			while (i < trace_size && trace_data[i] != '\n') {
+				i++;
+			}
+		} else if (trace_data[i] != '\n') {
+			break;
+		}
+		if (i < trace_size) {
+			i++;
+		}
+	}
+	if (trace_number(&i, time) < 0) {
+		goto error;
+	}
+	if (trace_number(&i, &value) < 0 || value < 1.0 || value > INT_MAX) {
+		goto error;
+	}
+	*size = (unsigned long)value;
+	if (trace_number(&i, &value) < 0) {
+		goto error;
+	}
+	*sid = (unsigned long)fmod(value, 65536.0);
+	while (i < trace_size && (trace_data[i] == ' ' || trace_data[i] == '\t' || trace_data[i] == '\r')) {
+		i++;
+	}
+	if (i < trace_size && trace_data[i] != '\n') {
+		goto error;
+	}
+	*offset = (i < trace_size) ? i + 1 : i;
+	return 1;
+error:
+	*offset = i;
+	return -1;
+}
+
+/*
+ * Returns the length of the next message. When replaying a trace, the
+ * record also gives the stream, and the thread waits until the message
+ * is due. Stamped messages are at least as long as their header.
+ */
+static int next_message(struct sender_info *info, uint16_t *sid)
+{
+	struct timespec ts;
+	unsigned long size, stream;
+	uint64_t now, due;
+	double time;
+	int len;
+
+	switch (size_distribution) {
+	case SIZE_UNIFORM:
+		len = (int)(size_min + next_random(&info->random) % (size_max - size_min + 1));
+		break;
+	case SIZE_EXPONENTIAL:
+		len = (int)(-size_mean * log(1.0 - next_unit(&info->random)) + 0.5);
+		if (len < 1) {
+			len = 1;
+		} else if ((unsigned int)len > size_max) {
+			len = (int)size_max;
+		}
+		break;
+	case SIZE_BIMODAL:
+		len = (int)((next_unit(&info->random) < size_fraction) ? size_max : size_min);
+		break;
+	case SIZE_TRACE:
+		if (trace_record(&info->trace_offset, &time, &size, &stream) <= 0) {
+			/* Start over. The time before the first record is not replayed. */
+			info->trace_offset = 0;
+			info->trace_start = 0;
+			trace_record(&info->trace_offset, &time, &size, &stream);
+		}
+		now = now_ns();
+		if (info->trace_start == 0) {
+			info->trace_start = now;
+			info->trace_base = time;
+		}
+		due = info->trace_start;
+		if (time > info->trace_base) {
+			due += (uint64_t)((time - info->trace_base) * 1000000000.0);
+		}
+		if (now < due) {
+			ts.tv_sec = due / 1000000000ULL;
+			ts.tv_nsec = due % 1000000000ULL;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !done);
+		}
+		*sid = (uint16_t)(stream % streams);
+		len = (int)size;
+		break;
+	default:
+		len = length;
+		break;
+	}
+	if (stamp_messages && len < PAYLOAD_HEADER_SIZE) {
+		len = PAYLOAD_HEADER_SIZE;
+	}
+	return len;
+}
+
+/* The body is the same for all messages, only its length varies. */
+static uint32_t message_checksum(struct sender_info *info, const char *buffer, int len)
+{
+	return (len == length) ? info->body_checksum : body_checksum(buffer, len);
+}
+
+/* The average length of the messages, used to turn a bit rate into a message rate. */
+static double mean_length(void)
+{
+	switch (size_distribution) {
+	case SIZE_UNIFORM:
+		return (size_min + size_max) / 2.0;
+	case SIZE_EXPONENTIAL:
+		/* Sizes above the maximum are cut off. */
+		return size_mean * (1.0 - exp(-(double)size_max / size_mean));
+	case SIZE_BIMODAL:
+		return size_fraction * size_max + (1.0 - size_fraction) * size_min;
+	case SIZE_TRACE:
+		return trace_bytes / trace_records;
+	default:
+		return length;
+	}
+}
+
+static ssize_t send_message(int fd, const char *buffer, size_t len, uint32_t ppid, uint32_t flags, uint16_t sid, unsigned int addr_index)
+{
+	struct sctp_sndrcvinfo sinfo;
+
+	if (one_to_many) {
+		memset(&sinfo, 0, sizeof(sinfo));
+		sinfo.sinfo_stream = sid;
+		sinfo.sinfo_flags = flags;
+		sinfo.sinfo_ppid = ppid;
+		sinfo.sinfo_timetolive = timetolive;
+		sinfo.sinfo_assoc_id = assoc_ids[addr_index];
+		return sctp_send(fd, buffer, len, &sinfo, 0);
+	} else {
+		return sctp_sendmsg(fd, buffer, len, NULL, 0, ppid, flags, sid, timetolive, 0);
+	}
+}
+
+/*
+ * Sends one message. In explicit EOR mode, the message is handed to the
+ * stack in pieces of piece_size bytes, all taken from the buffer, and
+ * only the last piece ends it. The time until the last piece was
+ * accepted is the completion time of the message.
+ */
+static ssize_t send_pieces(int fd, char *buffer, size_t len, uint32_t ppid, uint32_t flags, uint16_t sid, unsigned int addr_index, struct sender_info *info)
+{
+#if defined(SCTP_EXPLICIT_EOR)
+	size_t offset, part;
+	uint64_t start;
+
+	if (piece_size > 0) {
+		start = now_ns();
+		for (offset = 0; offset < len; offset += part) {
+			part = (len - offset < piece_size) ? len - offset : piece_size;
+			info->calls++;
+			if (send_message(fd, buffer, part, ppid,
+			                 (offset + part == len) ? (flags | SCTP_EOR) : (flags & ~(uint32_t)SCTP_EOF),
+			                 sid, addr_index) < 0) {
+				return -1;
+			}
+			if (offset == 0 && stamp_messages) {
+				/* The header is only sent in the first piece. */
+				memset(buffer, 'A', PAYLOAD_HEADER_SIZE);
+			}
+		}
+		histogram_add(&info->completion, now_ns() - start);
+		return (ssize_t)len;
+	}
+#endif
+	info->calls++;
+	return send_message(fd, buffer, len, ppid, flags, sid, addr_index);
+}
+
+static unsigned long send_bulk(int fd, char *buffer, unsigned int addr_index, struct sender_info *info)
+{
+	unsigned long i;
+	unsigned int allowance;
+	uint32_t flags;
+	uint32_t ppid;
+	uint16_t sid;
+	int len;
+
+	if (very_verbose) {
+		ppid = 0;
+	} else {
+		ppid = 39;
+	}
+	sid = first_stream(info->stream_credit);
+	flags = send_flags;
+	i = 0;
+	allowance = 0;
+	while (!done && !info->stop && ((number_of_messages == 0) || (i < (number_of_messages - 1)))) {
+		if (message_rate > 0.0) {
+			if (allowance == 0) {
+				allowance = pacer_wait(&info->pacer);
+			}
+			allowance--;
+		}
+		if (very_verbose) {
+			printf("Sending message number %lu.\n", i);
+		}
+		len = next_message(info, &sid);
+		if (stamp_messages) {
+			stamp_payload(buffer, sid, info->seqs[addr_index * streams + sid]++, message_checksum(info, buffer, len));
+		}
+		if (send_pieces(fd, buffer, len, htonl(ppid), flags, sid, addr_index, info) < 0) {
+			send_error(info, "sctp_sendmsg");
+			break;
+		}
+		info->bytes += len;
+		if (very_verbose) {
+			ppid += 1;
+		}
+		sid = next_stream(sid, info->stream_credit);
+		if (one_to_many && ++addr_index == nr_remote_addr) {
+			addr_index = 0;
+		}
+		i++;
+		info->messages = i;
+	}
+	if (very_verbose) {
+		printf("Sending message number %lu.\n", i);
+	}
+#if !defined(LINUX)
+	if (!one_to_many && !keep_open) {
+		flags |= SCTP_EOF;
+	}
+#endif
+	len = next_message(info, &sid);
+	if (stamp_messages) {
+		stamp_payload(buffer, sid, info->seqs[addr_index * streams + sid]++, message_checksum(info, buffer, len));
+	}
+	if (send_pieces(fd, buffer, len, htonl(ppid), flags, sid, addr_index, info) < 0) {
+		send_error(info, "sctp_sendmsg");
+	} else {
+		info->bytes += len;
+	}
+	i++;
+	return i;
+}
+
+static size_t put_varint(char *p, uint32_t value)
+{
+	size_t n;
+
+	for (n = 0; value >= 0x80; value >>= 7) {
+		p[n++] = (char)((value & 0x7f) | 0x80);
+	}
+	p[n++] = (char)value;
+	return n;
+}
+
+/* Sends the messages collected for a stream as one user message. */
+static int coalesce_flush(int fd, struct coalesce_buffer *c, uint16_t sid, uint32_t flags, struct sender_info *info)
+{
+	uint64_t now;
+	unsigned int j;
+	int result;
+
+	if (c->count == 0) {
+		return 0;
+	}
+	info->calls++;
+	if (send_message(fd, c->data, c->fill, htonl(COALESCE_PPID), flags, sid, 0) < 0) {
+		send_error(info, "sctp_sendmsg");
+		result = -1;
+	} else {
+		now = now_ns();
+		for (j = 0; j < c->count; j++) {
+			histogram_add(&info->delay, now - c->times[j]);
+		}
+		info->bytes += c->bytes;
+		info->user_messages++;
+		info->messages += c->count;
+		result = 0;
+	}
+	c->fill = COALESCE_HEADER_SIZE;
+	c->count = 0;
+	c->bytes = 0;
+	return result;
+}
+
+/*
+ * Sends the user messages whose first message is due before until. If
+ * until is in the future, the sender sleeps until each of them is due.
+ */
+static int coalesce_flush_due(int fd, struct coalesce_buffer *buffers, uint64_t until, struct sender_info *info)
+{
+	struct timespec ts;
+	uint64_t next;
+	uint16_t sid, first;
+
+	for (;;) {
+		next = 0;
+		first = 0;
+		for (sid = 0; sid < streams; sid++) {
+			if (buffers[sid].count > 0 && (next == 0 || buffers[sid].deadline < next)) {
+				next = buffers[sid].deadline;
+				first = sid;
+			}
+		}
+		if (next == 0 || next > until || done) {
+			return 0;
+		}
+		if (next > now_ns()) {
+			ts.tv_sec = next / 1000000000ULL;
+			ts.tv_nsec = next % 1000000000ULL;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !done);
+		}
+		if (coalesce_flush(fd, &buffers[first], first, send_flags, info) < 0) {
+			return -1;
+		}
+	}
+}
+
+/*
+ * Coalescing send path: the messages are collected per stream, each
+ * preceded by its length, behind a marker identifying the user message as
+ * coalesced. A user message is sent when the next message would not fit
+ * into coalesce_bytes any more or, with a time limit, when its first
+ * message has waited coalesce_usecs. Returns the number of messages sent.
+ */
+static unsigned long send_coalesced(int fd, char *buffer, unsigned int addr_index, struct sender_info *info)
+{
+	struct coalesce_buffer *buffers, *c;
+	unsigned long i;
+	unsigned int allowance;
+	size_t capacity;
+	uint32_t flags, magic;
+	uint64_t now;
+	uint16_t sid;
+#if !defined(LINUX)
+	uint16_t last;
+#endif
+	int len, failed;
+
+	/* A message larger than the limit is sent on its own. */
+	capacity = COALESCE_HEADER_SIZE + MAX_VARINT_SIZE + length;
+	if (capacity < coalesce_bytes) {
+		capacity = coalesce_bytes;
+	}
+	magic = htonl(COALESCE_MAGIC);
+	buffers = calloc(streams, sizeof(struct coalesce_buffer));
+	for (sid = 0; sid < streams; sid++) {
+		buffers[sid].data = malloc(capacity);
+		memcpy(buffers[sid].data, &magic, COALESCE_HEADER_SIZE);
+		buffers[sid].fill = COALESCE_HEADER_SIZE;
+		/* Each message takes at least two bytes. */
+		buffers[sid].times = malloc((capacity / 2 + 1) * sizeof(uint64_t));
+	}
+	sid = first_stream(info->stream_credit);
+	allowance = 0;
+	failed = 0;
+	for (i = 0; !failed && !done && !info->stop && ((number_of_messages == 0) || (i < number_of_messages)); i++) {
+		if (message_rate > 0.0) {
+			if (allowance == 0) {
+				/* Messages must not wait beyond their time while the sender sleeps. */
+				if (coalesce_usecs > 0 && coalesce_flush_due(fd, buffers, info->pacer.next, info) < 0) {
+					break;
+				}
+				allowance = pacer_wait(&info->pacer);
+			}
+			allowance--;
+		}
+		len = next_message(info, &sid);
+		c = &buffers[sid];
+		if (c->count > 0 && c->fill + MAX_VARINT_SIZE + len > coalesce_bytes) {
+			if (coalesce_flush(fd, c, sid, send_flags, info) < 0) {
+				break;
+			}
+		}
+		now = now_ns();
+		if (c->count == 0) {
+			c->deadline = now + coalesce_usecs * 1000ULL;
+		}
+		c->times[c->count++] = now;
+		c->fill += put_varint(c->data + c->fill, (uint32_t)len);
+		memcpy(c->data + c->fill, buffer, len);
+		if (stamp_messages) {
+			stamp_payload(c->data + c->fill, sid, info->seqs[addr_index * streams + sid]++, message_checksum(info, buffer, len));
+		}
+		c->fill += len;
+		c->bytes += len;
+		if (c->fill + MAX_VARINT_SIZE >= coalesce_bytes) {
+			failed = (coalesce_flush(fd, c, sid, send_flags, info) < 0);
+		} else if (coalesce_usecs > 0) {
+			failed = (coalesce_flush_due(fd, buffers, now, info) < 0);
+		}
+		sid = next_stream(sid, info->stream_credit);
+	}
+	/* Send what was collected, the last user message may end the association. */
+	for (sid = 0; !failed && sid < streams; sid++) {
+		flags = send_flags;
+#if !defined(LINUX)
+		for (last = sid + 1; last < streams && buffers[last].count == 0; last++);
+		if (last == streams && !keep_open) {
+			flags |= SCTP_EOF;
+		}
+#endif
+		failed = (coalesce_flush(fd, &buffers[sid], sid, flags, info) < 0);
+	}
+	for (sid = 0; sid < streams; sid++) {
+		free(buffers[sid].data);
+		free(buffers[sid].times);
+	}
+	free(buffers);
+	return info->messages;
+}
+
+#if defined(SCTP_SNDINFO)
+/*
+ * Batched send path: the msghdrs and their SCTP_SNDINFO (and SCTP_PRINFO)
+ * control messages are built once, only the fields changing from message
+ * to message are updated before handing a batch to sendmsg() or sendmmsg().
+ */
+static struct send_batch *send_batch_create(char *buffer, unsigned int size)
+{
+	struct send_batch *batch;
+	struct cmsghdr *cmsg;
+	struct msghdr *msg;
+#if defined(SCTP_PRINFO)
+	struct sctp_prinfo *prinfo;
+#endif
+	size_t control_len;
+	unsigned int j;
+
+	control_len = CMSG_SPACE(sizeof(struct sctp_sndinfo));
+#if defined(SCTP_PRINFO)
+	if (pr_policy != 0) {
+		control_len += CMSG_SPACE(sizeof(struct sctp_prinfo));
+	}
+#endif
+	batch = malloc(sizeof(struct send_batch));
+	batch->size = size;
+	batch->iov.iov_base = buffer;
+	batch->iov.iov_len = length;
+	if (stamp_messages || size_distribution != SIZE_FIXED) {
+		/* Each message gets its own header in front of the shared body, or its own length. */
+		batch->iovs = calloc(2 * size, sizeof(struct iovec));
+	} else {
+		batch->iovs = NULL;
+	}
+	batch->headers = stamp_messages ? calloc(size, PAYLOAD_HEADER_SIZE) : NULL;
+	batch->lengths = calloc(size, sizeof(int));
+	batch->sndinfo = calloc(size, sizeof(struct sctp_sndinfo *));
+	batch->control = calloc(size, control_len);
+#if defined(HAVE_SENDMMSG)
+	batch->msgs = calloc(size, sizeof(struct mmsghdr));
+#else
+	batch->msgs = calloc(size, sizeof(struct msghdr));
+#endif
+	for (j = 0; j < size; j++) {
+#if defined(HAVE_SENDMMSG)
+		msg = &batch->msgs[j].msg_hdr;
+#else
+		msg = &batch->msgs[j];
+#endif
+		if (stamp_messages) {
+			batch->iovs[2 * j].iov_base = batch->headers + j * PAYLOAD_HEADER_SIZE;
+			batch->iovs[2 * j].iov_len = PAYLOAD_HEADER_SIZE;
+			batch->iovs[2 * j + 1].iov_base = buffer + PAYLOAD_HEADER_SIZE;
+			batch->iovs[2 * j + 1].iov_len = length - PAYLOAD_HEADER_SIZE;
+			msg->msg_iov = &batch->iovs[2 * j];
+			msg->msg_iovlen = 2;
+		} else if (batch->iovs != NULL) {
+			batch->iovs[2 * j].iov_base = buffer;
+			batch->iovs[2 * j].iov_len = length;
+			msg->msg_iov = &batch->iovs[2 * j];
+			msg->msg_iovlen = 1;
+		} else {
+			msg->msg_iov = &batch->iov;
+			msg->msg_iovlen = 1;
+		}
+		msg->msg_control = batch->control + j * control_len;
+		msg->msg_controllen = control_len;
+		cmsg = CMSG_FIRSTHDR(msg);
+		cmsg->cmsg_level = IPPROTO_SCTP;
+		cmsg->cmsg_type = SCTP_SNDINFO;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(struct sctp_sndinfo));
+		batch->sndinfo[j] = (struct sctp_sndinfo *)CMSG_DATA(cmsg);
+		batch->sndinfo[j]->snd_flags = send_flags & ~pr_policy;
+#if defined(SCTP_PRINFO)
+		if (pr_policy != 0) {
+			cmsg = CMSG_NXTHDR(msg, cmsg);
+			cmsg->cmsg_level = IPPROTO_SCTP;
+			cmsg->cmsg_type = SCTP_PRINFO;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(struct sctp_prinfo));
+			prinfo = (struct sctp_prinfo *)CMSG_DATA(cmsg);
+			prinfo->pr_policy = pr_policy;
+			prinfo->pr_value = timetolive;
+		}
+#endif
+	}
+	return batch;
+}
+
+static void send_batch_free(struct send_batch *batch)
+{
+	free(batch->iovs);
+	free(batch->headers);
+	free(batch->lengths);
+	free(batch->msgs);
+	free(batch->control);
+	free(batch->sndinfo);
+	free(batch);
+}
+
+/* Sets the length of a message of the batch. */
+static void send_batch_length(struct send_batch *batch, unsigned int j, int len)
+{
+	batch->lengths[j] = len;
+	if (stamp_messages) {
+		batch->iovs[2 * j + 1].iov_len = len - PAYLOAD_HEADER_SIZE;
+	} else if (batch->iovs != NULL) {
+		batch->iovs[2 * j].iov_len = len;
+	}
+}
+
+/* Returns the number of messages handed to the kernel, or -1 on error. */
+static int send_batch_submit(int fd, struct send_batch *batch, unsigned int count)
+{
+	unsigned int j;
+
+#if defined(HAVE_SENDMMSG)
+	if (engine == 2) {
+		return sendmmsg(fd, batch->msgs, count, 0);
+	}
+	for (j = 0; j < count; j++) {
+		if (sendmsg(fd, &batch->msgs[j].msg_hdr, 0) < 0) {
+			return (j > 0) ? (int)j : -1;
+		}
+	}
+#else
+	for (j = 0; j < count; j++) {
+		if (sendmsg(fd, &batch->msgs[j], 0) < 0) {
+			return (j > 0) ? (int)j : -1;
+		}
+	}
+#endif
+	return (int)count;
+}
+
+static unsigned long send_bulk_batched(int fd, char *buffer, unsigned int addr_index, struct sender_info *info)
+{
+	struct send_batch *batch;
+	unsigned long i, remaining;
+	unsigned int count, j, allowance;
+	uint32_t ppid;
+	uint16_t sid;
+	int sent, len;
+
+	batch = send_batch_create(buffer, (engine == 2) ? batch_size : 1);
+	if (very_verbose) {
+		ppid = 0;
+	} else {
+		ppid = 39;
+	}
+	sid = first_stream(info->stream_credit);
+	i = 0;
+	allowance = 0;
+	while (!done && !info->stop && ((number_of_messages == 0) || (i < (number_of_messages - 1)))) {
+		count = batch->size;
+		if (number_of_messages > 0) {
+			remaining = number_of_messages - 1 - i;
+			if (remaining < count) {
+				count = (unsigned int)remaining;
+			}
+		}
+		if (message_rate > 0.0) {
+			if (allowance == 0) {
+				allowance = pacer_wait(&info->pacer);
+			}
+			if (allowance < count) {
+				count = allowance;
+			}
+		}
+		for (j = 0; j < count; j++) {
+			if (very_verbose) {
+				printf("Sending message number %lu.\n", i + j);
+			}
+			len = next_message(info, &sid);
+			send_batch_length(batch, j, len);
+			batch->sndinfo[j]->snd_sid = sid;
+			batch->sndinfo[j]->snd_ppid = htonl(very_verbose ? ppid + j : ppid);
+			if (one_to_many) {
+				batch->sndinfo[j]->snd_assoc_id = assoc_ids[(addr_index + j) % nr_remote_addr];
+			}
+			if (stamp_messages) {
+				stamp_payload(batch->headers + j * PAYLOAD_HEADER_SIZE, sid,
+				              info->seqs[((addr_index + j) % nr_remote_addr) * streams + sid]++,
+				              message_checksum(info, buffer, len));
+			}
+			sid = next_stream(sid, info->stream_credit);
+		}
+		info->calls += (engine == 2) ? 1 : count;
+		if ((sent = send_batch_submit(fd, batch, count)) < 0) {
+			send_error(info, "sendmsg");
+			break;
+		}
+		for (j = 0; j < (unsigned int)sent; j++) {
+			info->bytes += batch->lengths[j];
+		}
+		if (stamp_messages) {
+			/* Hand out the sequence numbers of the messages not sent again. */
+			for (j = sent; j < count; j++) {
+				info->seqs[((addr_index + j) % nr_remote_addr) * streams + batch->sndinfo[j]->snd_sid]--;
+			}
+		}
+		if ((unsigned int)sent < count) {
+			/* Messages not sent are retried on their stream. */
+			sid = batch->sndinfo[sent]->snd_sid;
+		}
+		if (message_rate > 0.0) {
+			allowance -= sent;
+		}
+		if (very_verbose) {
+			ppid += sent;
+		}
+		if (one_to_many) {
+			addr_index = (addr_index + sent) % nr_remote_addr;
+		}
+		i += sent;
+		info->messages = i;
+	}
+	if (very_verbose) {
+		printf("Sending message number %lu.\n", i);
+	}
+	len = next_message(info, &sid);
+	send_batch_length(batch, 0, len);
+	batch->sndinfo[0]->snd_sid = sid;
+	batch->sndinfo[0]->snd_ppid = htonl(ppid);
+	if (one_to_many) {
+		batch->sndinfo[0]->snd_assoc_id = assoc_ids[addr_index];
+	}
+#if !defined(LINUX)
+	if (!one_to_many && !keep_open) {
+		batch->sndinfo[0]->snd_flags |= SCTP_EOF;
+	}
+#endif
+	if (stamp_messages) {
+		stamp_payload(batch->headers, sid, info->seqs[addr_index * streams + sid]++, message_checksum(info, buffer, len));
+	}
+	info->calls++;
+	if (send_batch_submit(fd, batch, 1) < 0) {
+		send_error(info, "sendmsg");
+	} else {
+		info->bytes += len;
+	}
+	i++;
+	send_batch_free(batch);
+	return i;
+}
+#endif
+
+/*
+ * Request/response mode: keep up to outstanding requests in flight and
+ * record the round trip time of each transaction. If request and response
+ * are large enough, the send time travels in the first bytes of the request
+ * and is echoed by the receiver, so responses may arrive in any order.
+ * Otherwise responses are matched to requests in FIFO order.
+ */
+static unsigned long request_response(int fd, char *buffer, struct sender_info *info)
+{
+	struct sctp_sndrcvinfo sinfo;
+	unsigned long sent, completed;
+	unsigned int in_flight, head, tail;
+	uint64_t *send_times;
+	uint64_t send_time;
+	uint32_t ppid;
+	uint16_t sid;
+	char *rbuf;
+	ssize_t n;
+	int flags, embedded, in_response;
+	socklen_t len;
+
+	embedded = (length >= (int)sizeof(uint64_t)) && (response_length >= (int)sizeof(uint64_t));
+	send_times = malloc(outstanding * sizeof(uint64_t));
+	rbuf = malloc(BUFFERSIZE);
+	ppid = 39;
+	sid = first_stream(info->stream_credit);
+	sent = 0;
+	completed = 0;
+	in_flight = 0;
+	head = 0;
+	tail = 0;
+	in_response = 0;
+	send_time = 0;
+	while (!done && ((number_of_messages == 0) || (completed < number_of_messages))) {
+		while (in_flight < outstanding && ((number_of_messages == 0) || (sent < number_of_messages))) {
+			send_time = now_ns();
+			if (embedded) {
+				memcpy(buffer, &send_time, sizeof(uint64_t));
+			} else {
+				send_times[tail] = send_time;
+				tail = (tail + 1) % outstanding;
+			}
+			info->calls++;
+			if (sctp_sendmsg(fd, buffer, length, NULL, 0, htonl(ppid), send_flags, sid, timetolive, 0) < 0) {
+				perror("sctp_sendmsg");
+				goto out;
+			}
+			sid = next_stream(sid, info->stream_credit);
+			in_flight++;
+			sent++;
+		}
+		flags = 0;
+		len = (socklen_t)0;
+		info->calls++;
+		n = sctp_recvmsg(fd, (void*)rbuf, BUFFERSIZE, NULL, &len, &sinfo, &flags);
+		if (n <= 0) {
+			if (n < 0) {
+				perror("sctp_recvmsg");
+			}
+			break;
+		}
+		if (flags & MSG_NOTIFICATION) {
+			continue;
+		}
+		if (!in_response) {
+			if (embedded && n >= (ssize_t)sizeof(uint64_t)) {
+				memcpy(&send_time, rbuf, sizeof(uint64_t));
+			} else {
+				send_time = send_times[head];
+				head = (head + 1) % outstanding;
+			}
+			in_response = 1;
+		}
+		if (flags & MSG_EOR) {
+			histogram_add(&info->rtt, now_ns() - send_time);
+			in_response = 0;
+			in_flight--;
+			completed++;
+			info->messages = completed;
+			info->bytes += length;
+		}
+	}
+out:
+	free(rbuf);
+	free(send_times);
+	return completed;
+}
+
+static char *prepare_buffer(struct sender_info *info)
+{
+	char *buffer;
+	size_t size;
+
+	/* In explicit EOR mode, the buffer holds one piece. */
+	size = (piece_size > 0) ? piece_size : (size_t)length;
+	buffer = malloc(size);
+	memset(buffer, 'A', size);
+	info->stream_credit = calloc(streams, sizeof(long));
+	if (info->random == 0) {
+		/* Each thread draws its own, but a reproducible, sequence of sizes. */
+		info->random = 0x9e3779b97f4a7c15ULL * (info->index + 1);
+	}
+	if (stamp_messages) {
+		/* The sequence numbers continue on associations kept open by a sweep. */
+		if (info->seqs == NULL) {
+			info->seqs = calloc((nr_remote_addr > 0 ? nr_remote_addr : 1) * streams, sizeof(uint32_t));
+		}
+		info->body_checksum = body_checksum(buffer, length);
+	}
+	return buffer;
+}
+
+#if defined(SCTP_SENDER_DRY_EVENT)
+static int subscribe_sender_dry(int fd, int on)
+{
+#if defined(USRSCTP)
+	struct sctp_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.se_type = SCTP_SENDER_DRY_EVENT;
+	event.se_on = on;
+	if (setsockopt(fd, IPPROTO_SCTP, SCTP_EVENT, &event, sizeof(event)) < 0) {
+		perror("setsockopt: SCTP_EVENT");
+		return -1;
+	}
+#else
+	struct sctp_event_subscribe event;
+	socklen_t len;
+
+	/* SCTP_EVENTS replaces all subscriptions. */
+	memset(&event, 0, sizeof(event));
+	len = (socklen_t)sizeof(event);
+	if (getsockopt(fd, IPPROTO_SCTP, SCTP_EVENTS, &event, &len) < 0) {
+		perror("getsockopt: SCTP_EVENTS");
+		return -1;
+	}
+	event.sctp_sender_dry_event = on;
+	if (setsockopt(fd, IPPROTO_SCTP, SCTP_EVENTS, &event, sizeof(event)) < 0) {
+		perror("setsockopt: SCTP_EVENTS");
+		return -1;
+	}
+#endif
+	return 0;
+}
+
+/*
+ * Waits until the peer has acknowledged all data sent. The SENDER_DRY
+ * event is subscribed to only now: the stack then reports it once, right
+ * away if nothing is outstanding anymore, otherwise when the last data is
+ * acknowledged. Returns -1 if the association failed meanwhile.
+ */
+static int wait_until_dry(int fd)
+{
+	union sctp_notification *notification;
+	struct sctp_sndrcvinfo sinfo;
+	char *buf;
+	ssize_t n;
+	int flags, result;
+
+	if (subscribe_sender_dry(fd, 1) < 0) {
+		return -1;
+	}
+	buf = malloc(BUFFERSIZE);
+	result = -1;
+	for (;;) {
+		flags = 0;
+		n = sctp_recvmsg(fd, (void*)buf, BUFFERSIZE, NULL, NULL, &sinfo, &flags);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			if (n < 0) {
+				perror("sctp_recvmsg");
+			}
+			break;
+		}
+		notification = (union sctp_notification *)buf;
+		if ((flags & MSG_NOTIFICATION) && notification->sn_header.sn_type == SCTP_SENDER_DRY_EVENT) {
+			result = 0;
+			break;
+		}
+	}
+	free(buf);
+	/* A kept association must not queue events while the next point of a sweep is sent. */
+	if (result == 0) {
+		subscribe_sender_dry(fd, 0);
+	}
+	return result;
+}
+#endif
+
+/*
+ * Reads how many messages PR-SCTP abandoned on the association, before or
+ * after they were sent, in total and, unless per_stream_status is NULL,
+ * on each stream. Returns -1 if the stack doesn't count them.
+ */
+static int read_pr_status(int fd, sctp_assoc_t assoc_id, struct pr_status *total, struct pr_status *per_stream_status)
+{
+#if defined(SCTP_PR_ASSOC_STATUS)
+	struct sctp_prstatus status;
+	socklen_t len;
+	uint16_t sid;
+
+	memset(&status, 0, sizeof(status));
+	status.sprstat_assoc_id = assoc_id;
+	status.sprstat_policy = pr_policy;
+	len = (socklen_t)sizeof(status);
+	if (getsockopt(fd, IPPROTO_SCTP, SCTP_PR_ASSOC_STATUS, &status, &len) < 0) {
+		return -1;
+	}
+	total->unsent = status.sprstat_abandoned_unsent;
+	total->sent = status.sprstat_abandoned_sent;
+#if defined(SCTP_PR_STREAM_STATUS)
+	for (sid = 0; per_stream_status != NULL && sid < streams; sid++) {
+		memset(&status, 0, sizeof(status));
+		status.sprstat_assoc_id = assoc_id;
+		status.sprstat_sid = sid;
+		status.sprstat_policy = pr_policy;
+		len = (socklen_t)sizeof(status);
+		if (getsockopt(fd, IPPROTO_SCTP, SCTP_PR_STREAM_STATUS, &status, &len) == 0) {
+			per_stream_status[sid].unsent = status.sprstat_abandoned_unsent;
+			per_stream_status[sid].sent = status.sprstat_abandoned_sent;
+		}
+	}
+#endif
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/* The counters of a kept association include the previous points of a sweep. */
+static void pr_status_start(struct sender_info *info, int fd)
+{
+	if (per_stream) {
+		info->stream_abandoned = calloc(streams, sizeof(struct pr_status));
+	}
+	info->has_pr_status = (pr_policy != 0 && read_pr_status(fd, 0, &info->abandoned, info->stream_abandoned) == 0);
+}
+
+static void pr_status_stop(struct sender_info *info, int fd)
+{
+	struct pr_status total, *stream_status;
+	uint16_t sid;
+
+	if (!info->has_pr_status) {
+		return;
+	}
+	stream_status = per_stream ? calloc(streams, sizeof(struct pr_status)) : NULL;
+	if (read_pr_status(fd, 0, &total, stream_status) < 0) {
+		info->has_pr_status = 0;
+	} else {
+		info->abandoned.unsent = total.unsent - info->abandoned.unsent;
+		info->abandoned.sent = total.sent - info->abandoned.sent;
+		for (sid = 0; stream_status != NULL && sid < streams; sid++) {
+			info->stream_abandoned[sid].unsent = stream_status[sid].unsent - info->stream_abandoned[sid].unsent;
+			info->stream_abandoned[sid].sent = stream_status[sid].sent - info->stream_abandoned[sid].sent;
+		}
+	}
+	free(stream_status);
+}
+
+static unsigned long send_data(int fd, char *buffer, unsigned int addr_index, struct sender_info *info)
+{
+	if (coalesce_bytes > 0) {
+		return send_coalesced(fd, buffer, addr_index, info);
+	}
+#if defined(SCTP_SNDINFO)
+	if (engine != 0) {
+		return send_bulk_batched(fd, buffer, addr_index, info);
+	}
+#endif
+	return send_bulk(fd, buffer, addr_index, info);
+}
+
+/* Client side of the duplex mode: receives until the peer has shut down. */
+static void* duplex_receive(void *arg)
+{
+	struct connection *conn;
+
+	conn = (struct connection *)arg;
+	receive_until_eof(conn);
+	/* The socket is closed by the sending thread. */
+	conn->fd = -1;
+	connection_finish(conn);
+	return NULL;
+}
+
+/* Server side of the duplex mode: sends until the peer shuts down. */
+static void* duplex_send(void *arg)
+{
+	struct sender_info *info;
+	char *buffer;
+
+	info = (struct sender_info *)arg;
+	buffer = prepare_buffer(info);
+	gettimeofday(&info->start_time, NULL);
+	if (cpu_cost) {
+		cost_start(&info->cost);
+	}
+	info->messages = send_data(info->fd, buffer, 0, info);
+	if (cpu_cost) {
+		cost_stop(&info->cost, info->bytes, info->messages, info->calls);
+	}
+	gettimeofday(&info->stop_time, NULL);
+	free(buffer);
+	free(info->stream_credit);
+	free(info->seqs);
+	return NULL;
+}
+
+static void* send_messages(void *arg)
+{
+	struct sender_info *info;
+	struct connection *duplex_conn;
+	struct linger linger;
+	pthread_t duplex_tid;
+	unsigned long i;
+	unsigned int addr_index;
+	char *buffer;
+	int fd;
+
+	info = (struct sender_info *)arg;
+	pin_thread(info->cpu);
+
+	addr_index = info->index % nr_remote_addr;
+	if (one_to_many) {
+		fd = one_to_many_fd;
+	} else if (info->fd >= 0) {
+		/* Kept open from the previous point of the sweep. */
+		fd = info->fd;
+		set_sender_options(fd);
+	} else {
+		fd = create_socket(1);
+		if (duplex) {
+			set_receive_options(fd);
+		}
+		if (connect_socket(fd, addr_index, verbose && info->index == 0) < 0) {
+			close_socket(fd);
+			fd = -1;
+		}
+	}
+	info->fd = one_to_many ? -1 : fd;
+	buffer = prepare_buffer(info);
+	duplex_conn = NULL;
+	if (duplex && fd >= 0) {
+		duplex_conn = malloc(sizeof(struct connection));
+		connection_init(duplex_conn, fd);
+		if (pthread_create(&duplex_tid, NULL, &duplex_receive, (void *)duplex_conn) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	if (fd >= 0 && !one_to_many) {
+		pr_status_start(info, fd);
+#ifdef SCTP_AUTH_CHUNK
+		info->auth_data = peer_authenticates_data(fd, 0);
+		info->has_auth = (info->auth_data >= 0);
+#endif
+	}
+	pthread_barrier_wait(&start_barrier);
+	gettimeofday(&info->start_time, NULL);
+	i = 0;
+	if (fd < 0) {
+		gettimeofday(&info->stop_time, NULL);
+		goto out;
+	}
+
+	if (cpu_cost) {
+		cost_start(&info->cost);
+	}
+	if (response_length > 0) {
+		i = request_response(fd, buffer, info);
+	} else {
+		i = send_data(fd, buffer, addr_index, info);
+	}
+	if (cpu_cost) {
+		cost_stop(&info->cost, info->bytes, i, info->calls);
+	}
+	gettimeofday(&info->enqueued_time, NULL);
+	info->stop_time = info->enqueued_time;
+#if defined(SCTP_SENDER_DRY_EVENT)
+	/* The receiving thread of the duplex mode would take the event. */
+	if (!one_to_many && duplex_conn == NULL && response_length == 0 && wait_until_dry(fd) == 0) {
+		gettimeofday(&info->stop_time, NULL);
+		info->acknowledged = 1;
+	}
+#endif
+	if (!one_to_many) {
+		pr_status_stop(info, fd);
+	}
+	if (duplex_conn != NULL) {
+		/*
+		 * The counters of the association are gone after the shutdown,
+		 * which also ends the sending of the peer. Wait for its data.
+		 */
+		report_transport(fd, 0, "sender", (long long)info->index);
+		if (shutdown(fd, SHUT_WR) < 0) {
+			perror("shutdown");
+		}
+		pthread_join(duplex_tid, NULL);
+		free(duplex_conn);
+	}
+	if (!one_to_many && !keep_associations) {
+		linger.l_onoff = 1;
+		linger.l_linger = LINGERTIME;
+		if (setsockopt(fd, SOL_SOCKET, SO_LINGER,(char*)&linger, sizeof(struct linger)) < 0) {
+			perror("setsockopt");
+		}
+		/* The main thread samples the socket while holding the lock. */
+		pthread_mutex_lock(&senders_mutex);
+		info->fd = -1;
+		pthread_mutex_unlock(&senders_mutex);
+		close_socket(fd);
+	}
+out:
+	free(buffer);
+	free(info->stream_credit);
+	info->messages = i;
+	pthread_mutex_lock(&senders_mutex);
+	senders_running--;
+	pthread_cond_signal(&senders_cond);
+	pthread_mutex_unlock(&senders_mutex);
+	return NULL;
+}
+
+static int deadline_passed(const struct timespec *deadline)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return now.tv_sec > deadline->tv_sec ||
+	       (now.tv_sec == deadline->tv_sec && now.tv_usec * 1000 >= deadline->tv_nsec);
+}
+
+#ifdef SCTP_AUTH_CHUNK
+/* Makes the next key the active one on all associations. */
+static void rotate_keys(struct sender_info *senders, unsigned int number_of_senders)
+{
+	unsigned int i;
+
+	key_changes++;
+	if (one_to_many) {
+		for (i = 0; i < nr_remote_addr; i++) {
+			rotate_key(one_to_many_fd, assoc_ids[i]);
+		}
+	} else {
+		for (i = 0; i < number_of_senders; i++) {
+			if (senders[i].fd >= 0) {
+				rotate_key(senders[i].fd, 0);
+			}
+		}
+	}
+}
+#endif
+
+/*
+ * Waits for all sender threads to finish. With -d, the progress of the
+ * threads is sampled every round_duration seconds meanwhile. With key
+ * rotation, the active key is changed every auth_rotate seconds.
+ */
+static void wait_for_senders(struct sender_info *senders, unsigned int number_of_senders)
+{
+	struct timeval round_start, now, diff_time;
+	struct timespec deadline, rotation, wakeup;
+	unsigned long *last, messages, delta;
+	unsigned long long *last_bytes, bytes, delta_bytes;
+	double seconds;
+	struct record rec;
+	unsigned int i;
+
+	last = calloc(number_of_senders, sizeof(unsigned long));
+	last_bytes = calloc(number_of_senders, sizeof(unsigned long long));
+	gettimeofday(&round_start, NULL);
+	deadline.tv_sec = round_start.tv_sec + round_duration;
+	deadline.tv_nsec = round_start.tv_usec * 1000;
+	rotation.tv_sec = round_start.tv_sec + auth_rotate;
+	rotation.tv_nsec = deadline.tv_nsec;
+	pthread_mutex_lock(&senders_mutex);
+	while (senders_running > 0) {
+		if (round_duration == 0 && auth_rotate == 0) {
+			pthread_cond_wait(&senders_cond, &senders_mutex);
+			continue;
+		}
+		if (round_duration == 0 || (auth_rotate > 0 && rotation.tv_sec < deadline.tv_sec)) {
+			wakeup = rotation;
+		} else {
+			wakeup = deadline;
+		}
+		if (pthread_cond_timedwait(&senders_cond, &senders_mutex, &wakeup) != ETIMEDOUT) {
+			continue;
+		}
+#ifdef SCTP_AUTH_CHUNK
+		if (auth_rotate > 0 && deadline_passed(&rotation)) {
+			rotate_keys(senders, number_of_senders);
+			rotation.tv_sec += auth_rotate;
+		}
+#endif
+		if (round_duration == 0 || !deadline_passed(&deadline)) {
+			continue;
+		}
+		gettimeofday(&now, NULL);
+		timersub(&now, &round_start, &diff_time);
+		seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000.0;
+		memset(&rec, 0, sizeof(rec));
+		rec.side = "sender";
+		rec.type = "interval";
+		rec.seconds = seconds;
+		messages = 0;
+		bytes = 0;
+		for (i = 0; i < number_of_senders; i++) {
+			delta = senders[i].messages - last[i];
+			last[i] += delta;
+			messages += delta;
+			delta_bytes = senders[i].bytes - last_bytes[i];
+			last_bytes[i] += delta_bytes;
+			bytes += delta_bytes;
+			if (output_format != OUTPUT_TEXT && number_of_senders > 1) {
+				rec.assoc_id = i;
+				rec.messages = delta;
+				rec.bytes = delta_bytes;
+				print_record(&rec);
+			}
+		}
+		if (output_format == OUTPUT_TEXT) {
+			fprintf(stdout, "throughput for the last %f seconds: %f B/s\n", seconds, (double)bytes / seconds);
+		} else {
+			rec.assoc_id = -1;
+			rec.messages = messages;
+			rec.bytes = bytes;
+			print_record(&rec);
+		}
+		if (sample_transport_stats) {
+			if (one_to_many) {
+				for (i = 0; i < nr_remote_addr; i++) {
+					report_transport(one_to_many_fd, assoc_ids[i], "sender", (long long)i);
+				}
+			} else {
+				for (i = 0; i < number_of_senders; i++) {
+					if (senders[i].fd >= 0) {
+						report_transport(senders[i].fd, 0, "sender", (long long)i);
+					}
+				}
+			}
+		}
+		round_start = now;
+		deadline.tv_sec += round_duration;
+		/* The receive side of the duplex mode reports its interval with the senders. */
+		report_round++;
+	}
+	pthread_mutex_unlock(&senders_mutex);
+	for (i = 0; i < number_of_senders; i++) {
+		pthread_join(senders[i].tid, NULL);
+	}
+	free(last);
+	free(last_bytes);
+}
+
+static void merge_sender_info(struct sender_info *total, const struct sender_info *info, int first)
+{
+	if (first || timercmp(&info->start_time, &total->start_time, <)) {
+		total->start_time = info->start_time;
+	}
+	if (first || timercmp(&info->stop_time, &total->stop_time, >)) {
+		total->stop_time = info->stop_time;
+	}
+	if (first || timercmp(&info->enqueued_time, &total->enqueued_time, >)) {
+		total->enqueued_time = info->enqueued_time;
+	}
+	total->acknowledged = (first || total->acknowledged) && info->acknowledged;
+	total->has_pr_status = (first || total->has_pr_status) && info->has_pr_status;
+	total->abandoned.unsent += info->abandoned.unsent;
+	total->abandoned.sent += info->abandoned.sent;
+	total->user_messages += info->user_messages;
+	total->has_auth = (first || total->has_auth) && info->has_auth;
+	total->auth_data = (first || total->auth_data) && info->auth_data;
+	histogram_merge(&total->delay, &info->delay);
+	histogram_merge(&total->completion, &info->completion);
+	total->messages += info->messages;
+	total->bytes += info->bytes;
+	histogram_merge(&total->rtt, &info->rtt);
+	if (cpu_cost) {
+		cost_merge(&total->cost, &info->cost, first);
+	}
+	total->pacer.late += info->pacer.late;
+	total->pacer.total_lag += info->pacer.total_lag;
+	if (info->pacer.max_lag > total->pacer.max_lag) {
+		total->pacer.max_lag = info->pacer.max_lag;
+	}
+}
+
+static void print_sender_result(const char *prefix, long long assoc_id, struct sender_info *info)
+{
+	struct timeval diff_time;
+	double seconds, enqueued_seconds;
+	double throughput;
+	double requested;
+	unsigned long long abandoned;
+	uint16_t sid;
+
+	timersub(&info->stop_time, &info->start_time, &diff_time);
+	seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000;
+	enqueued_seconds = 0.0;
+	if (info->acknowledged) {
+		timersub(&info->enqueued_time, &info->start_time, &diff_time);
+		enqueued_seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000;
+	}
+	if (output_format != OUTPUT_TEXT) {
+		struct record rec;
+
+		memset(&rec, 0, sizeof(rec));
+		rec.side = "sender";
+		rec.type = "result";
+		rec.assoc_id = assoc_id;
+		rec.bytes = info->bytes;
+		rec.messages = info->messages;
+		rec.seconds = seconds;
+		rec.latency = (response_length > 0) ? &info->rtt : NULL;
+		rec.cost = cpu_cost ? &info->cost : NULL;
+		rec.enqueued_seconds = enqueued_seconds;
+		rec.abandoned = info->has_pr_status ? &info->abandoned : NULL;
+		rec.user_messages = info->user_messages;
+		if (response_length == 0 && info->delay.count > 0) {
+			rec.latency = &info->delay;
+		}
+		if (piece_size > 0) {
+			rec.latency = &info->completion;
+			rec.peak_memory = peak_memory();
+		}
+		rec.has_auth = info->has_auth;
+		rec.auth_data = info->auth_data;
+		print_record(&rec);
+		for (sid = 0; info->has_pr_status && info->stream_abandoned != NULL && sid < streams; sid++) {
+			memset(&rec, 0, sizeof(rec));
+			rec.side = "sender";
+			rec.type = "stream";
+			rec.assoc_id = assoc_id;
+			rec.has_stream = 1;
+			rec.stream = sid;
+			rec.abandoned = &info->stream_abandoned[sid];
+			print_record(&rec);
+		}
+		return;
+	}
+	if (size_distribution == SIZE_FIXED) {
+		fprintf(stdout, "%s%s of %ld messages of length %u took %f seconds.\n",
+		       prefix, "Sending", info->messages, length, seconds);
+	} else {
+		fprintf(stdout, "%s%s of %ld messages with %llu bytes (%f bytes on average) took %f seconds.\n",
+		       prefix, "Sending", info->messages, info->bytes,
+		       (info->messages > 0) ? (double)info->bytes / info->messages : 0.0, seconds);
+	}
+	throughput = (double)info->bytes / seconds;
+	fprintf(stdout, "%sThroughput was %f Byte/sec.\n", prefix, throughput);
+	if (enqueued_seconds > 0.0) {
+		/* The time taken is until the peer acknowledged all data. */
+		fprintf(stdout, "%sAll messages were enqueued after %f seconds (%f Byte/sec) and acknowledged %f seconds later.\n",
+		        prefix, enqueued_seconds, (double)info->bytes / enqueued_seconds, seconds - enqueued_seconds);
+	}
+	if (coalesce_bytes > 0) {
+		fprintf(stdout, "%sCoalesced %lu messages into %lu user messages, %f messages/sec.\n",
+		        prefix, info->messages, info->user_messages, (double)info->messages / seconds);
+		if (info->delay.count > 0) {
+			print_histogram(prefix, "Coalescing delay", &info->delay);
+		}
+	}
+#ifdef SCTP_AUTH_CHUNK
+	if (info->has_auth) {
+		/* The peer decides which chunks it wants to receive authenticated. */
+		fprintf(stdout, "%sDATA chunks were %s.\n",
+		        prefix, info->auth_data ? "authenticated" : "not authenticated, the peer did not ask for it");
+		if (info->auth_data && auth_rotate > 0 && assoc_id < 0) {
+			fprintf(stdout, "%sThe active key was changed %lu times.\n", prefix, key_changes);
+		}
+	}
+#endif
+	if (piece_size > 0) {
+		fprintf(stdout, "%sMessages were sent in pieces of %u bytes, peak resident memory was %.0f bytes.\n",
+		        prefix, piece_size, peak_memory());
+		print_histogram(prefix, "Message completion", &info->completion);
+	}
+	if (info->has_pr_status) {
+		/* The receiver reports what was actually delivered. */
+		abandoned = info->abandoned.unsent + info->abandoned.sent;
+		fprintf(stdout, "%sPR-SCTP abandoned %llu messages (%f%%), %llu before and %llu after sending them, "
+		        "the goodput of the others was %f Byte/sec.\n",
+		        prefix, abandoned, (info->messages > 0) ? 100.0 * abandoned / info->messages : 0.0,
+		        (unsigned long long)info->abandoned.unsent, (unsigned long long)info->abandoned.sent,
+		        (info->messages > 0 && abandoned < info->messages) ? throughput * (1.0 - (double)abandoned / info->messages) : 0.0);
+		for (sid = 0; info->stream_abandoned != NULL && sid < streams; sid++) {
+			fprintf(stdout, "%sStream %u: abandoned %llu messages before and %llu after sending them.\n",
+			        prefix, sid,
+			        (unsigned long long)info->stream_abandoned[sid].unsent,
+			        (unsigned long long)info->stream_abandoned[sid].sent);
+		}
+	}
+	if (cpu_cost) {
+		print_cost(prefix, &info->cost);
+	}
+	if (response_length > 0) {
+		fprintf(stdout, "%sTransactions per second were %f.\n", prefix, (double)info->messages / seconds);
+		print_histogram(prefix, "RTT", &info->rtt);
+	}
+	if (message_rate > 0.0) {
+		/* Each thread is paced to its share, the aggregate to the full rate. */
+		requested = (info->pacer.interval > 0) ? 1000000000.0 * burst / info->pacer.interval : message_rate;
+		fprintf(stdout, "%sRequested %f messages/sec (%f bit/sec), achieved %f messages/sec (%f bit/sec).\n",
+		        prefix,
+		        requested, requested * mean_length() * 8.0,
+		        (double)info->messages / seconds, throughput * 8.0);
+		fprintf(stdout, "%sSender was behind schedule for %lu bursts, by at most %f ms, on average %f ms.\n",
+		        prefix, info->pacer.late,
+		        info->pacer.max_lag / 1000000.0,
+		        (info->pacer.late > 0) ? (double)info->pacer.total_lag / info->pacer.late / 1000000.0 : 0.0);
+	}
+}
+
+static void open_one_to_many(void)
+{
+	unsigned int i;
+
+	one_to_many_fd = create_socket(1);
+	for (i = 0; i < nr_remote_addr; i++) {
+		if (connect_socket(one_to_many_fd, i, verbose && i == 0) < 0) {
+			exit(1);
+		}
+	}
+}
+
+/* Shuts down the one-to-many socket and the sockets kept open by the senders. */
+static void close_associations(struct sender_info *senders, unsigned int number_of_senders)
+{
+	struct sctp_sndrcvinfo sinfo;
+	struct linger linger;
+	unsigned int i;
+
+	linger.l_onoff = 1;
+	linger.l_linger = LINGERTIME;
+	if (one_to_many && one_to_many_fd >= 0) {
+		for (i = 0; i < nr_remote_addr; i++) {
+			memset(&sinfo, 0, sizeof(sinfo));
+			sinfo.sinfo_flags = SCTP_EOF;
+			sinfo.sinfo_assoc_id = assoc_ids[i];
+			if (sctp_send(one_to_many_fd, NULL, 0, &sinfo, 0) < 0) {
+				perror("sctp_send");
+			}
+		}
+		if (setsockopt(one_to_many_fd, SOL_SOCKET, SO_LINGER,(char*)&linger, sizeof(struct linger)) < 0) {
+			perror("setsockopt");
+		}
+		close_socket(one_to_many_fd);
+		one_to_many_fd = -1;
+	}
+	for (i = 0; i < number_of_senders; i++) {
+		if (senders[i].fd >= 0) {
+			if (setsockopt(senders[i].fd, SOL_SOCKET, SO_LINGER,(char*)&linger, sizeof(struct linger)) < 0) {
+				perror("setsockopt");
+			}
+			close_socket(senders[i].fd);
+			senders[i].fd = -1;
+		}
+		free(senders[i].seqs);
+		senders[i].seqs = NULL;
+		free(senders[i].stream_abandoned);
+		senders[i].stream_abandoned = NULL;
+	}
+}
+
+/*
+ * Runs the sender threads once and merges their results into total.
+ * Messages sent during the first warmup seconds are not counted.
+ */
+static void run_senders(struct sender_info *senders, unsigned int number_of_senders,
+                        unsigned int runtime, unsigned int warmup,
+                        int *cpus, unsigned int nr_cpus, struct sender_info *total)
+{
+	unsigned long *warmup_messages;
+	unsigned long long *warmup_bytes;
+	uint32_t *seqs;
+	struct pr_status *abandoned, after;
+	struct timeval warmup_end;
+	struct timespec ts;
+	unsigned int i;
+	int fd, has_pr_status;
+
+	warmup_messages = calloc(number_of_senders, sizeof(unsigned long));
+	warmup_bytes = calloc(number_of_senders, sizeof(unsigned long long));
+	pthread_barrier_init(&start_barrier, NULL, number_of_senders + 1);
+	senders_running = number_of_senders;
+	done = 0;
+	key_changes = 0;
+	/* The associations of a one-to-many socket are shared by the threads. */
+	abandoned = NULL;
+	has_pr_status = 0;
+	if (one_to_many && pr_policy != 0) {
+		abandoned = calloc(nr_remote_addr, sizeof(struct pr_status));
+		has_pr_status = 1;
+		for (i = 0; i < nr_remote_addr; i++) {
+			if (read_pr_status(one_to_many_fd, assoc_ids[i], &abandoned[i], NULL) < 0) {
+				has_pr_status = 0;
+			}
+		}
+	}
+	for (i = 0; i < number_of_senders; i++) {
+		fd = senders[i].fd;
+		seqs = senders[i].seqs;
+		free(senders[i].stream_abandoned);
+		memset(&senders[i], 0, sizeof(struct sender_info));
+		senders[i].index = i;
+		senders[i].cpu = (nr_cpus > 0) ? cpus[i % nr_cpus] : -1;
+		senders[i].fd = fd;
+		senders[i].seqs = seqs;
+		if (message_rate > 0.0) {
+			/* The requested rate is shared by all threads. */
+			senders[i].pacer.interval = (uint64_t)(1000000000.0 * burst * number_of_senders / message_rate);
+		}
+		if (pthread_create(&senders[i].tid, NULL, &send_messages, (void *)&senders[i]) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	pthread_barrier_wait(&start_barrier);
+	if (verbose && !very_verbose) {
+		printf("Start sending %ld messages...", (long)number_of_messages);
+		fflush(stdout);
+	}
+	if (runtime > 0) {
+		signal(SIGALRM, stop_sender);
+		alarm(runtime + warmup);
+	}
+	if (warmup > 0) {
+		ts.tv_sec = warmup;
+		ts.tv_nsec = 0;
+		while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+		gettimeofday(&warmup_end, NULL);
+		for (i = 0; i < number_of_senders; i++) {
+			warmup_messages[i] = senders[i].messages;
+			warmup_bytes[i] = senders[i].bytes;
+		}
+	}
+	wait_for_senders(senders, number_of_senders);
+	if (verbose && !very_verbose)
+		printf("done.\n");
+
+	memset(total, 0, sizeof(struct sender_info));
+	for (i = 0; i < number_of_senders; i++) {
+		if (warmup > 0) {
+			if (timercmp(&senders[i].stop_time, &warmup_end, >)) {
+				senders[i].messages -= warmup_messages[i];
+				senders[i].bytes -= warmup_bytes[i];
+				senders[i].start_time = warmup_end;
+				if (timercmp(&senders[i].enqueued_time, &warmup_end, <)) {
+					senders[i].enqueued_time = warmup_end;
+				}
+			} else {
+				senders[i].messages = 0;
+				senders[i].bytes = 0;
+				senders[i].start_time = senders[i].stop_time;
+			}
+		}
+		merge_sender_info(total, &senders[i], i == 0);
+	}
+	if (has_pr_status) {
+		total->has_pr_status = 1;
+		for (i = 0; i < nr_remote_addr; i++) {
+			if (read_pr_status(one_to_many_fd, assoc_ids[i], &after, NULL) < 0) {
+				total->has_pr_status = 0;
+				break;
+			}
+			total->abandoned.unsent += after.unsent - abandoned[i].unsent;
+			total->abandoned.sent += after.sent - abandoned[i].sent;
+		}
+	}
+	free(abandoned);
+	pthread_barrier_destroy(&start_barrier);
+	free(warmup_messages);
+	free(warmup_bytes);
+}
+
+/*
+ * Association setup benchmark: each thread sets up associations one
+ * after the other, sends number_of_messages on each and closes it, or
+ * keeps it open when holding associations. The setup time is the time
+ * connect() takes, i.e. the four-way handshake.
+ */
+static void* setup_associations(void *arg)
+{
+	struct sender_info *info;
+	struct linger linger;
+	unsigned int addr_index;
+	char *buffer;
+	uint64_t start;
+	int fd;
+
+	info = (struct sender_info *)arg;
+	pin_thread(info->cpu);
+	addr_index = info->index % nr_remote_addr;
+	buffer = prepare_buffer(info);
+	linger.l_onoff = 1;
+	linger.l_linger = LINGERTIME;
+
+	pthread_barrier_wait(&start_barrier);
+	gettimeofday(&info->start_time, NULL);
+	while (!done && (info->setup_limit == 0 || info->associations + info->failures < info->setup_limit)) {
+		start = now_ns();
+		if ((fd = create_socket(1)) < 0) {
+			info->failures++;
+			continue;
+		}
+		if (connect_socket(fd, addr_index, 0) < 0) {
+			info->failures++;
+			close_socket(fd);
+			continue;
+		}
+		histogram_add(&info->setup, now_ns() - start);
+		info->associations++;
+		if (number_of_messages > 0) {
+			if (info->seqs != NULL) {
+				/* Each association starts with sequence number 0. */
+				memset(info->seqs, 0, nr_remote_addr * streams * sizeof(uint32_t));
+			}
+			info->messages += send_data(fd, buffer, addr_index, info);
+		}
+		if (info->held != NULL) {
+			info->held[info->nr_held++] = fd;
+		} else {
+			if (setsockopt(fd, SOL_SOCKET, SO_LINGER, (char*)&linger, sizeof(struct linger)) < 0) {
+				perror("setsockopt");
+			}
+			close_socket(fd);
+		}
+	}
+	gettimeofday(&info->stop_time, NULL);
+	free(buffer);
+	free(info->stream_credit);
+	return NULL;
+}
+
+/* Resident size of this process and memory in use system wide, in bytes. */
+static int memory_usage(long long *process, long long *system)
+{
+#if defined(LINUX)
+	FILE *f;
+	char line[128];
+	long long size, resident, total, available;
+
+	if ((f = fopen("/proc/self/statm", "r")) == NULL) {
+		return -1;
+	}
+	if (fscanf(f, "%lld %lld", &size, &resident) != 2) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	*process = resident * sysconf(_SC_PAGESIZE);
+	if ((f = fopen("/proc/meminfo", "r")) == NULL) {
+		return -1;
+	}
+	total = -1;
+	available = -1;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		sscanf(line, "MemTotal: %lld kB", &total);
+		sscanf(line, "MemAvailable: %lld kB", &available);
+	}
+	fclose(f);
+	if (total < 0 || available < 0) {
+		return -1;
+	}
+	*system = (total - available) * 1024;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * The memory used per association is only known for all threads together,
+ * process_memory and system_memory are negative otherwise.
+ */
+static void print_setup_result(const char *prefix, long long assoc_id, struct sender_info *info,
+                               double process_memory, double system_memory)
+{
+	struct timeval diff_time;
+	double seconds;
+
+	timersub(&info->stop_time, &info->start_time, &diff_time);
+	seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000;
+	if (output_format != OUTPUT_TEXT) {
+		struct record rec;
+
+		memset(&rec, 0, sizeof(rec));
+		rec.side = "sender";
+		rec.type = "setup";
+		rec.assoc_id = assoc_id;
+		rec.bytes = info->bytes;
+		/* The message rate column carries the association setup rate. */
+		rec.messages = info->associations;
+		rec.seconds = seconds;
+		rec.latency = &info->setup;
+		rec.has_setup = 1;
+		rec.failures = info->failures;
+		rec.process_memory = process_memory;
+		rec.system_memory = system_memory;
+		print_record(&rec);
+		return;
+	}
+	fprintf(stdout, "%sSetting up %lu associations (%lu failed) took %f seconds, %f associations/sec.\n",
+	        prefix, info->associations, info->failures, seconds, (double)info->associations / seconds);
+	if (info->setup.count > 0) {
+		print_histogram(prefix, "Setup time", &info->setup);
+	}
+	if (process_memory >= 0.0) {
+		fprintf(stdout, "%sMemory used per association: %f bytes by this process, %f bytes system wide.\n",
+		        prefix, process_memory, system_memory);
+	}
+}
+
+/*
+ * Runs the setup benchmark. When holding associations, the target is
+ * shared by the threads and the associations stay open for runtime
+ * seconds once all have been set up.
+ */
+static void run_setup(struct sender_info *senders, unsigned int number_of_senders,
+                      unsigned int runtime, int *cpus, unsigned int nr_cpus)
+{
+	struct sender_info total;
+	struct linger linger;
+	struct timespec ts;
+	long long process_before, system_before, process_after, system_after;
+	double process_memory, system_memory;
+	char prefix[32];
+	unsigned long j;
+	unsigned int i;
+	int have_memory;
+
+	if (hold_target > 0 && number_of_senders > hold_target) {
+		number_of_senders = (unsigned int)hold_target;
+	}
+	/* Held associations stay up until the end of the run. */
+	if (hold_target > 0) {
+		keep_open = 1;
+	}
+	have_memory = (hold_target > 0 && memory_usage(&process_before, &system_before) == 0);
+	pthread_barrier_init(&start_barrier, NULL, number_of_senders + 1);
+	done = 0;
+	for (i = 0; i < number_of_senders; i++) {
+		memset(&senders[i], 0, sizeof(struct sender_info));
+		senders[i].index = i;
+		senders[i].cpu = (nr_cpus > 0) ? cpus[i % nr_cpus] : -1;
+		senders[i].fd = -1;
+		if (hold_target > 0) {
+			senders[i].setup_limit = hold_target / number_of_senders + (i < hold_target % number_of_senders);
+			senders[i].held = calloc(senders[i].setup_limit, sizeof(int));
+		} else {
+			senders[i].setup_limit = setup_count;
+		}
+		if (pthread_create(&senders[i].tid, NULL, &setup_associations, (void *)&senders[i]) != 0) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+	pthread_barrier_wait(&start_barrier);
+	if (runtime > 0 && hold_target == 0) {
+		signal(SIGALRM, stop_sender);
+		alarm(runtime);
+	}
+	memset(&total, 0, sizeof(struct sender_info));
+	for (i = 0; i < number_of_senders; i++) {
+		pthread_join(senders[i].tid, NULL);
+		merge_sender_info(&total, &senders[i], i == 0);
+		total.associations += senders[i].associations;
+		total.failures += senders[i].failures;
+		histogram_merge(&total.setup, &senders[i].setup);
+		total.nr_held += senders[i].nr_held;
+	}
+	process_memory = -1.0;
+	system_memory = -1.0;
+	if (have_memory && total.nr_held > 0 && memory_usage(&process_after, &system_after) == 0) {
+		process_memory = (double)(process_after - process_before) / total.nr_held;
+		system_memory = (double)(system_after - system_before) / total.nr_held;
+	}
+	if (number_of_senders > 1) {
+		for (i = 0; i < number_of_senders; i++) {
+			snprintf(prefix, sizeof(prefix), "Thread %u: ", i);
+			print_setup_result(prefix, (long long)i, &senders[i], -1.0, -1.0);
+		}
+	}
+	print_setup_result("", -1, &total, process_memory, system_memory);
+	fflush(stdout);
+	if (hold_target > 0) {
+		if (runtime > 0) {
+			ts.tv_sec = runtime;
+			ts.tv_nsec = 0;
+			while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+		}
+		linger.l_onoff = 1;
+		linger.l_linger = LINGERTIME;
+		for (i = 0; i < number_of_senders; i++) {
+			for (j = 0; j < senders[i].nr_held; j++) {
+				if (setsockopt(senders[i].held[j], SOL_SOCKET, SO_LINGER, (char*)&linger, sizeof(struct linger)) < 0) {
+					perror("setsockopt");
+				}
+				close_socket(senders[i].held[j]);
+			}
+			free(senders[i].held);
+			senders[i].held = NULL;
+		}
+	}
+	for (i = 0; i < number_of_senders; i++) {
+		free(senders[i].seqs);
+		senders[i].seqs = NULL;
+	}
+	pthread_barrier_destroy(&start_barrier);
+}
+
+/* Maps a policy number of -P to the flag of the stack, -1 if not supported. */
+static int pr_policy_value(long policy)
+{
+	switch (policy) {
+	case 0:
+#ifdef SCTP_PR_SCTP_NONE
+		return SCTP_PR_SCTP_NONE;
+#else
+		return 0;
+#endif
+#ifdef SCTP_PR_SCTP_TTL
+	case 1:
+		return SCTP_PR_SCTP_TTL;
+#endif
+#ifdef SCTP_PR_SCTP_RTX
+	case 2:
+		return SCTP_PR_SCTP_RTX;
+#endif
+#if defined(SCTP_PR_SCTP_BUF)
+	case 3:
+		return SCTP_PR_SCTP_BUF;
+#elif defined(SCTP_PR_SCTP_PRIO)
+	case 3:
+		return SCTP_PR_SCTP_PRIO;
+#endif
+	default:
+		return -1;
+	}
+}
+
+static void set_pr_policy(int policy)
+{
+	send_flags = (send_flags & ~pr_policy) | policy;
+	pr_policy = (uint16_t)policy;
+}
+
+/*
+ * Parses name=list, where list is a comma separated list of values and
+ * ranges first-last, first-last:step and first-last*factor. Ranges with
+ * first > last count down.
+ */
+static int parse_sweep(char *arg)
+{
+	struct sweep_parameter *p;
+	char *list, *token, *end;
+	long first, last, step, value;
+	int d, multiply;
+
+	if ((list = strchr(arg, '=')) == NULL) {
+		return -1;
+	}
+	*list++ = '\0';
+	p = NULL;
+	for (d = 0; d < NUMBER_OF_SWEEP_PARAMETERS; d++) {
+		if (strcmp(arg, sweep[d].name) == 0) {
+			p = &sweep[d];
+		}
+	}
+	if (p == NULL) {
+		return -1;
+	}
+	free(p->values);
+	p->values = NULL;
+	p->nr_values = 0;
+	for (token = strtok(list, ","); token != NULL; token = strtok(NULL, ",")) {
+		first = strtol(token, &end, 0);
+		if (end == token || first < 0) {
+			return -1;
+		}
+		last = first;
+		step = 1;
+		multiply = 0;
+		if (*end == '-') {
+			token = end + 1;
+			last = strtol(token, &end, 0);
+			if (end == token || last < 0) {
+				return -1;
+			}
+			if (*end == ':' || *end == '*') {
+				multiply = (*end == '*');
+				token = end + 1;
+				step = strtol(token, &end, 0);
+				if (end == token || step < 1 || (multiply && (step < 2 || first == 0 || last == 0))) {
+					return -1;
+				}
+			}
+		}
+		if (*end != '\0') {
+			return -1;
+		}
+		value = first;
+		while ((first <= last) ? (value <= last) : (value >= last)) {
+			if (p->nr_values == MAX_SWEEP_VALUES) {
+				return -1;
+			}
+			if ((p->values = realloc(p->values, (p->nr_values + 1) * sizeof(long))) == NULL) {
+				perror("realloc");
+				exit(1);
+			}
+			p->values[p->nr_values++] = value;
+			if (multiply) {
+				value = (first <= last) ? value * step : value / step;
+			} else {
+				value = (first <= last) ? value + step : value - step;
+			}
+		}
+	}
+	return (p->nr_values > 0) ? 0 : -1;
+}
+
+/* A parameter which is not swept takes the single value given. */
+static void sweep_default(struct sweep_parameter *p, long value)
+{
+	if (p->nr_values > 0) {
+		return;
+	}
+	if ((p->values = malloc(sizeof(long))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	p->values[0] = value;
+	p->nr_values = 1;
+}
+
+static void print_sweep_header(void)
+{
+	switch (output_format) {
+	case OUTPUT_CSV:
+		fprintf(stdout, "length,streams,sndbuf,nodelay,policy,prvalue,coalesce,messages,bytes,seconds,throughput,"
+		                "abandoned_unsent,abandoned_sent,abandoned_rate,goodput\n");
+		break;
+	case OUTPUT_JSON:
+		break;
+	default:
+		fprintf(stdout, "%8s %7s %10s %7s %6s %8s %8s %12s %10s %16s %10s %16s\n",
+		        "length", "streams", "sndbuf", "nodelay", "policy", "prvalue", "coalesce", "messages", "seconds", "throughput",
+		        "abandoned", "goodput");
+		break;
+	}
+	fflush(stdout);
+}
+
+/*
+ * Besides the throughput, a point of a sweep reports the share of the
+ * messages PR-SCTP abandoned and the goodput of the remaining ones.
+ */
+static void print_sweep_result(const struct sender_info *total, long policy)
+{
+	struct timeval diff_time;
+	double seconds, throughput, rate, goodput;
+
+	timersub(&total->stop_time, &total->start_time, &diff_time);
+	seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000.0;
+	throughput = (seconds > 0.0) ? (double)total->bytes / seconds : 0.0;
+	rate = 0.0;
+	if (total->has_pr_status && total->messages > 0) {
+		rate = (double)(total->abandoned.unsent + total->abandoned.sent) / total->messages;
+		if (rate > 1.0) {
+			rate = 1.0;
+		}
+	}
+	goodput = throughput * (1.0 - rate);
+	switch (output_format) {
+	case OUTPUT_CSV:
+		fprintf(stdout, "%d,%u,%d,%d,%ld,%u,%u,%lu,%llu,%f,%f,",
+		        length, streams, sndbufsize, nodelay, policy, timetolive, coalesce_bytes, total->messages,
+		        total->bytes, seconds, throughput);
+		if (total->has_pr_status) {
+			fprintf(stdout, "%llu,%llu,%f,%f\n",
+			        (unsigned long long)total->abandoned.unsent, (unsigned long long)total->abandoned.sent,
+			        rate, goodput);
+		} else {
+			fprintf(stdout, ",,,%f\n", goodput);
+		}
+		break;
+	case OUTPUT_JSON:
+		fprintf(stdout, "{\"side\": \"sender\", \"type\": \"sweep\", \"length\": %d, \"streams\": %u, \"sndbuf\": %d, \"nodelay\": %d, "
+		                "\"policy\": %ld, \"prvalue\": %u, \"coalesce\": %u, "
+		                "\"messages\": %lu, \"bytes\": %llu, \"seconds\": %f, \"throughput\": %f",
+		        length, streams, sndbufsize, nodelay, policy, timetolive, coalesce_bytes, total->messages,
+		        total->bytes, seconds, throughput);
+		if (total->has_pr_status) {
+			fprintf(stdout, ", \"abandoned_unsent\": %llu, \"abandoned_sent\": %llu, \"abandoned_rate\": %f",
+			        (unsigned long long)total->abandoned.unsent, (unsigned long long)total->abandoned.sent, rate);
+		}
+		fprintf(stdout, ", \"goodput\": %f}\n", goodput);
+		break;
+	default:
+		fprintf(stdout, "%8d %7u %10d %7d %6ld %8u %8u %12lu %10.3f %16.1f %9.3f%% %16.1f\n",
+		        length, streams, sndbufsize, nodelay, policy, timetolive, coalesce_bytes, total->messages, seconds, throughput,
+		        100.0 * rate, goodput);
+		break;
+	}
+	fflush(stdout);
+}
+
+/*
+ * Runs every combination of the sweep parameters. Associations are set up
+ * again for each point, unless they are kept and the number of streams
+ * stays the same.
+ */
+static void run_sweep(struct sender_info *senders, unsigned int number_of_senders,
+                      unsigned int runtime, unsigned int warmup,
+                      int *cpus, unsigned int nr_cpus, double bit_rate)
+{
+	unsigned int index[NUMBER_OF_SWEEP_PARAMETERS];
+	struct sender_info total;
+	uint16_t last_streams;
+	int d;
+
+	memset(index, 0, sizeof(index));
+	last_streams = 0;
+	print_sweep_header();
+	for (;;) {
+		nodelay = (int)sweep[SWEEP_NODELAY].values[index[SWEEP_NODELAY]];
+		sndbufsize = (int)sweep[SWEEP_SNDBUF].values[index[SWEEP_SNDBUF]];
+		streams = (uint16_t)sweep[SWEEP_STREAMS].values[index[SWEEP_STREAMS]];
+		length = (int)sweep[SWEEP_LENGTH].values[index[SWEEP_LENGTH]];
+		set_pr_policy(pr_policy_value(sweep[SWEEP_POLICY].values[index[SWEEP_POLICY]]));
+		timetolive = (unsigned int)sweep[SWEEP_PRVALUE].values[index[SWEEP_PRVALUE]];
+		coalesce_bytes = (unsigned int)sweep[SWEEP_COALESCE].values[index[SWEEP_COALESCE]];
+		if (!keep_associations || streams != last_streams) {
+			close_associations(senders, number_of_senders);
+			if (one_to_many) {
+				open_one_to_many();
+			}
+			last_streams = streams;
+		}
+		if (bit_rate > 0.0) {
+			message_rate = bit_rate / (8.0 * mean_length());
+		}
+		run_senders(senders, number_of_senders, runtime, warmup, cpus, nr_cpus, &total);
+		print_sweep_result(&total, sweep[SWEEP_POLICY].values[index[SWEEP_POLICY]]);
+		for (d = NUMBER_OF_SWEEP_PARAMETERS - 1; d >= 0; d--) {
+			if (++index[d] < sweep[d].nr_values) {
+				break;
+			}
+			index[d] = 0;
+		}
+		if (d < 0) {
+			break;
+		}
+	}
+	close_associations(senders, number_of_senders);
+}
+
+#ifdef SCTP_AUTH_CHUNK
+/* Parses a chunk type to authenticate, or hmac=sha1|sha256, key=hex or rotate=seconds. */
+static int parse_auth(const char *arg)
+{
+	char digits[3];
+	char *end;
+	unsigned long value;
+
+	if (strncmp(arg, "hmac=", 5) == 0) {
+		if (strcmp(arg + 5, "sha1") == 0) {
+			hmac_ident = SCTP_AUTH_HMAC_ID_SHA1;
+		} else if (strcmp(arg + 5, "sha256") == 0) {
+			hmac_ident = SCTP_AUTH_HMAC_ID_SHA256;
+		} else {
+			return -1;
+		}
+		return 0;
+	}
+	if (strncmp(arg, "key=", 4) == 0) {
+		auth_key_length = 0;
+		for (arg += 4; *arg != '\0'; arg += 2) {
+			if (auth_key_length == MAX_AUTH_KEY_LENGTH || arg[1] == '\0') {
+				return -1;
+			}
+			digits[0] = arg[0];
+			digits[1] = arg[1];
+			digits[2] = '\0';
+			value = strtoul(digits, &end, 16);
+			if (*end != '\0') {
+				return -1;
+			}
+			auth_key[auth_key_length++] = (unsigned char)value;
+		}
+		return (auth_key_length > 0) ? 0 : -1;
+	}
+	if (strncmp(arg, "rotate=", 7) == 0) {
+		auth_rotate = (unsigned int)strtoul(arg + 7, &end, 10);
+		return (*end == '\0' && auth_rotate > 0) ? 0 : -1;
+	}
+	value = strtoul(arg, &end, 10);
+	if (end == arg || *end != '\0' || value > 255) {
+		return -1;
+	}
+	if (number_of_chunks_to_auth < 256) {
+		chunk[number_of_chunks_to_auth++] = (unsigned char)value;
+	}
+	return 0;
+}
+#endif
+
+/* Parses a rate with an optional k, M or G suffix. */
+static double parse_rate(const char *arg)
+{
+	char *end;
+	double rate;
+
+	rate = strtod(arg, &end);
+	switch (*end) {
+	case 'k':
+		rate *= 1000.0;
+		break;
+	case 'M':
+		rate *= 1000000.0;
+		break;
+	case 'G':
+		rate *= 1000000000.0;
+		break;
+	default:
+		break;
+	}
+	return rate;
+}
+
+/* Parses a size with an optional k, M or G suffix, in powers of 1024. */
+static unsigned long long parse_size(const char *arg, char **end)
+{
+	unsigned long long size;
+
+	size = strtoull(arg, end, 10);
+	switch (**end) {
+	case 'k':
+		size <<= 10;
+		(*end)++;
+		break;
+	case 'M':
+		size <<= 20;
+		(*end)++;
+		break;
+	case 'G':
+		size <<= 30;
+		(*end)++;
+		break;
+	default:
+		break;
+	}
+	return size;
+}
+
+/*
+ * Parses the size distribution, one of fixed, uniform:min-max,
+ * exp:mean[,max] and bimodal:small,large,fraction. The largest size
+ * becomes the length of the send buffer.
+ */
+static int parse_size_distribution(char *arg)
+{
+	char *end;
+
+	if (strcmp(arg, "fixed") == 0) {
+		size_distribution = SIZE_FIXED;
+		return 0;
+	}
+	if (strncmp(arg, "uniform:", 8) == 0) {
+		size_distribution = SIZE_UNIFORM;
+		size_min = (unsigned int)strtoul(arg + 8, &end, 10);
+		if (*end != '-') {
+			return -1;
+		}
+		size_max = (unsigned int)strtoul(end + 1, &end, 10);
+		return (*end == '\0' && size_min > 0 && size_min <= size_max) ? 0 : -1;
+	}
+	if (strncmp(arg, "exp:", 4) == 0) {
+		size_distribution = SIZE_EXPONENTIAL;
+		size_mean = strtod(arg + 4, &end);
+		if (*end == ',') {
+			size_max = (unsigned int)strtoul(end + 1, &end, 10);
+		} else {
+			size_max = (unsigned int)(16.0 * size_mean);
+		}
+		return (*end == '\0' && size_mean >= 1.0 && size_max >= 1) ? 0 : -1;
+	}
+	if (strncmp(arg, "bimodal:", 8) == 0) {
+		size_distribution = SIZE_BIMODAL;
+		size_min = (unsigned int)strtoul(arg + 8, &end, 10);
+		if (*end != ',') {
+			return -1;
+		}
+		size_max = (unsigned int)strtoul(end + 1, &end, 10);
+		if (*end != ',') {
+			return -1;
+		}
+		size_fraction = strtod(end + 1, &end);
+		return (*end == '\0' && size_min > 0 && size_min <= size_max &&
+		        size_fraction >= 0.0 && size_fraction <= 1.0) ? 0 : -1;
+	}
+	return -1;
+}
+
+/*
+ * Maps the trace file. The pages are read on demand while the records are
+ * sent; the trace is only scanned once up front to check it and to find
+ * the largest message.
+ */
+static int open_trace(const char *name)
+{
+	struct stat st;
+	unsigned long size, sid;
+	size_t offset;
+	double time;
+	void *data;
+	int fd, result;
+
+	if ((fd = open(name, O_RDONLY)) < 0) {
+		perror("open");
+		return -1;
+	}
+	if (fstat(fd, &st) < 0) {
+		perror("fstat");
+		close(fd);
+		return -1;
+	}
+	if (st.st_size == 0) {
+		printf("Trace %s contains no messages\n", name);
+		close(fd);
+		return -1;
+	}
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+#if defined(MADV_SEQUENTIAL)
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+	trace_data = data;
+	trace_size = (size_t)st.st_size;
+	size_distribution = SIZE_TRACE;
+	size_max = 0;
+	offset = 0;
+	while ((result = trace_record(&offset, &time, &size, &sid)) > 0) {
+		trace_records++;
+		trace_bytes += size;
+		if (size > size_max) {
+			size_max = (unsigned int)size;
+		}
+	}
+	if (result < 0) {
+		printf("Malformed record in trace %s at offset %lu\n", name, (unsigned long)offset);
+		return -1;
+	}
+	if (trace_records == 0) {
+		printf("Trace %s contains no messages\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+/* Creates the socket the server accepts associations on. */
+static int open_listener(void)
+{
+	int fd;
+	int myrcvbufsize;
+	socklen_t intlen;
+
+	fd = create_socket(0);
+	if (listen(fd, backlog) < 0)
+		perror("listen");
+	if (rcvbufsize)
+		if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbufsize, sizeof(int)) < 0)
+			perror("setsockopt: rcvbuf");
+#ifdef SCTP_PARTIAL_DELIVERY_POINT
+	/* Messages larger than this are handed to the application in pieces of at least this size. */
+	if (piece_size > 0) {
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_PARTIAL_DELIVERY_POINT, &piece_size, sizeof(piece_size)) < 0) {
+			perror("setsockopt: partial delivery point");
+		}
+	}
+#endif
+#ifdef SCTP_NODELAY
+	/* Responses are sent on the accepted sockets, which inherit this setting. */
+	if (nodelay == 1) {
+		if (setsockopt(fd, IPPROTO_SCTP, SCTP_NODELAY, (char *)&on, sizeof(on)) < 0) {
+			perror("setsockopt: nodelay");
+		}
+	}
+#endif
+	if (verbose) {
+		intlen = sizeof(int);
+		if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &myrcvbufsize, &intlen) < 0) {
+			perror("setsockopt: rcvbuf");
+		} else {
+			fprintf(stdout,"Receive buffer size: %d.\n", myrcvbufsize);
+		}
+	}
+	set_receive_options(fd);
+	return fd;
+}
+
+/*
+ * Samples the counters of all associations every round_duration seconds
+ * and prints the throughput of the server and of its busiest associations.
+ * Advancing report_round makes each connection print its own interval on
+ * its next receive, no connection has to read the clock for it.
+ */
+static void *report_aggregate(void *arg)
+{
+	struct timeval round_start, now, diff_time;
+	struct timespec ts;
+	struct record rec;
+	unsigned long long *last_bytes, bytes, total_bytes, last_total_bytes, delta;
+	unsigned long *last_generation, total_messages, last_total_messages;
+	unsigned long untracked_now;
+	unsigned int i, j, k, n, associations;
+	long long *top_ids;
+	double *top_rates, seconds, rate;
+
+	(void)arg;
+	last_bytes = calloc(MAX_CONNECTION_SLOTS, sizeof(unsigned long long));
+	last_generation = calloc(MAX_CONNECTION_SLOTS, sizeof(unsigned long));
+	top_ids = calloc(top_associations + 1, sizeof(long long));
+	top_rates = calloc(top_associations + 1, sizeof(double));
+	if (last_bytes == NULL || last_generation == NULL || top_ids == NULL || top_rates == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+	last_total_bytes = 0;
+	last_total_messages = 0;
+	gettimeofday(&round_start, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	while (!done) {
+		ts.tv_sec += round_duration;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !done);
+		report_round++;
+		gettimeofday(&now, NULL);
+		timersub(&now, &round_start, &diff_time);
+		seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000.0;
+		round_start = now;
+
+		n = 0;
+		associations = 0;
+		pthread_mutex_lock(&slots_mutex);
+		total_bytes = closed_bytes;
+		total_messages = closed_messages;
+		untracked_now = untracked;
+		for (i = 0; i < MAX_CONNECTION_SLOTS; i++) {
+			if (!slots[i].c.used) {
+				continue;
+			}
+			associations++;
+			bytes = slot_bytes(&slots[i]);
+			total_bytes += bytes;
+			total_messages += slots[i].c.messages;
+			if (slots[i].c.generation != last_generation[i]) {
+				last_generation[i] = slots[i].c.generation;
+				last_bytes[i] = 0;
+			}
+			delta = bytes - last_bytes[i];
+			last_bytes[i] += delta;
+			if (top_associations == 0) {
+				continue;
+			}
+			/* Keeps the top_associations largest rates, in descending order. */
+			rate = (seconds > 0.0) ? (double)delta / seconds : 0.0;
+			for (j = n; j > 0 && top_rates[j - 1] < rate; j--);
+			if (j < top_associations) {
+				for (k = (n < top_associations) ? n : top_associations - 1; k > j; k--) {
+					top_rates[k] = top_rates[k - 1];
+					top_ids[k] = top_ids[k - 1];
+				}
+				top_rates[j] = rate;
+				top_ids[j] = slots[i].c.assoc_id;
+				if (n < top_associations) {
+					n++;
+				}
+			}
+		}
+		pthread_mutex_unlock(&slots_mutex);
+
+		if (output_format == OUTPUT_TEXT) {
+			flockfile(stdout);
+			fprintf(stdout, "Server: %u associations, throughput for the last %f seconds: %f B/s, %f messages/sec.\n",
+			        associations, seconds,
+			        (seconds > 0.0) ? (double)(total_bytes - last_total_bytes) / seconds : 0.0,
+			        (seconds > 0.0) ? (double)(total_messages - last_total_messages) / seconds : 0.0);
+			if (untracked_now > 0) {
+				fprintf(stdout, "%lu more associations exceed the %u slots, their bytes are counted when they end.\n", untracked_now, MAX_CONNECTION_SLOTS);
+			}
+			for (j = 0; j < n; j++) {
+				fprintf(stdout, "  Association %lld: %f B/s.\n", top_ids[j], top_rates[j]);
+			}
+			funlockfile(stdout);
+		} else {
+			memset(&rec, 0, sizeof(rec));
+			rec.side = "receiver";
+			rec.type = "aggregate";
+			rec.assoc_id = -1;
+			rec.bytes = total_bytes - last_total_bytes;
+			rec.messages = total_messages - last_total_messages;
+			rec.seconds = seconds;
+			rec.has_associations = 1;
+			rec.associations = associations;
+			print_record(&rec);
+			for (j = 0; j < n; j++) {
+				memset(&rec, 0, sizeof(rec));
+				rec.side = "receiver";
+				rec.type = "top";
+				rec.assoc_id = top_ids[j];
+				rec.bytes = (unsigned long long)(top_rates[j] * seconds);
+				rec.seconds = seconds;
+				print_record(&rec);
+			}
+		}
+		last_total_bytes = total_bytes;
+		last_total_messages = total_messages;
+	}
+	free(last_bytes);
+	free(last_generation);
+	free(top_ids);
+	free(top_rates);
+	return NULL;
+}
+
+/* Hands each accepted association to a thread of its own or to one of the receive workers. */
+static void serve(int fd, int *cpus, unsigned int nr_cpus, int number_of_workers)
+{
+	union sock_union remote_addr;
+	socklen_t addr_len;
+	pthread_t tid;
+	int *cfdptr;
+#if defined(HAVE_SYS_EPOLL_H)
+	unsigned int next_worker = 0;
+	struct receive_worker *workers = NULL;
+#endif
+
+	if (one_to_many) {
+		one_to_many_fd = fd;
+		receive_one_to_many(fd);
+	}
+#if defined(HAVE_SYS_EPOLL_H)
+	if (number_of_workers > 0) {
+		workers = start_receive_workers(number_of_workers, cpus, nr_cpus);
+	}
+#endif
+
+	while (1) {
+		memset(&remote_addr, 0, sizeof(remote_addr));
+
+		if (ipv4only) {
+			addr_len = sizeof(struct sockaddr_in);
+		} else {
+			addr_len = sizeof(struct sockaddr_in6);
+		}
+
+		cfdptr = malloc(sizeof(int));
+		if ((*cfdptr = accept(fd, (struct sockaddr *)&remote_addr, &addr_len)) < 0) {
+			perror("accept");
+			continue;
+		}
+		if (verbose) {
+			char temp[INET6_ADDRSTRLEN];
+
+			if (remote_addr.sa.sa_family == AF_INET) {
+				fprintf(stdout,"Connection accepted from %s:%d\n", inet_ntop(AF_INET, &remote_addr.s4.sin_addr, temp, INET_ADDRSTRLEN), ntohs(remote_addr.s4.sin_port));
+			} else if (remote_addr.sa.sa_family == AF_INET6) {
+				fprintf(stdout,"Connection accepted from %s:%d\n", inet_ntop(AF_INET6, &remote_addr.s6.sin6_addr, temp, INET6_ADDRSTRLEN), ntohs(remote_addr.s6.sin6_port));
+			}
+		}
+#if defined(HAVE_SYS_EPOLL_H)
+		if (workers != NULL) {
+			add_to_receive_worker(&workers[next_worker], *cfdptr);
+			next_worker = (next_worker + 1) % number_of_workers;
+			free(cfdptr);
+			continue;
+		}
+#endif
+		pthread_create(&tid, NULL, &handle_connection, (void *) cfdptr);
+	}
+	close_socket(fd);
+}
+
+#if defined(USRSCTP)
+static void* loopback_server(void *arg)
+{
+	serve(*(int *)arg, NULL, 0, 0);
+	return NULL;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	int fd, c;
+	char *local_addr_ptr = (char*) local_addr;
+	int client;
+	uint16_t local_port, remote_port, port;
+	unsigned long i;
+#if defined(USRSCTP)
+	pthread_t tid;
+#endif
+	unsigned int runtime = 0;
+	unsigned int warmup = 0;
+	int sweeping = 0;
+	int messages_given = 0;
+	int policy = 0;
+	int unordered = 0;
+	unsigned int number_of_associations = 1;
+	struct sender_info *senders;
+	struct sender_info total;
+	char prefix[32];
+	int cpus[MAX_CPUS];
+	unsigned int nr_cpus = 0;
+	double bit_rate = 0.0;
+	int number_of_workers = 0;
+
+	streams            = 1;
+	length             = DEFAULT_LENGTH;
+	number_of_messages = DEFAULT_NUMBER_OF_MESSAGES;
+	port               = DEFAULT_PORT;
+	verbose            = 0;
+	very_verbose       = 0;
+	round_duration     = 0;
+	response_length    = 0;
+	outstanding        = 1;
+	engine             = 0;
+	batch_size         = DEFAULT_BATCH_SIZE;
+	recv_buffer_size   = BUFFERSIZE;
+	message_rate       = 0.0;
+	burst              = 1;
+	one_to_many_fd     = -1;
+	backlog            = DEFAULT_BACKLOG;
+
+	memset((void *) remote_addrs, 0, sizeof(remote_addrs));
+
+	while ((c = getopt(argc, argv, "a:"
+#ifdef SCTP_AUTH_CHUNK
+	                               "A:"
+#endif
+#if defined(HAVE_SENDMMSG)
+	                               "b:"
+#endif
+	                               "B:"
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+	                               "c:"
+#endif
+	                               "C:d:D"
+#if defined(SCTP_SNDINFO) && !defined(USRSCTP)
+	                               "e:"
+#endif
+	                               "Ef:Fg:G:h:H:"
 #if defined(SCTP_INTERLEAVING_SUPPORTED)
                                        "I"
 #endif
-                                       "l:L:n:p:P:R:s:S:t:T:u"
+                                       "ij:J:k:Kl:L:m"
+#if defined(USRSCTP)
+                                       "M:"
+#endif
+                                       "n:N:o:O:p:P:q:Qr:R:s:S:t:T:u"
 #ifdef SCTP_REMOTE_UDP_ENCAPS_PORT 
                                    "U:"
 #endif
-                                   "vV46")) != -1)
+                                   "vVW:x:X"
+#if defined(SCTP_STREAM_SCHEDULER)
+                                   "y:"
+#endif
+                                   "Y:zZ:"
+#if defined(HAVE_SYS_EPOLL_H)
+                                   "w:"
+#endif
+                                   "46")) != -1)
 		switch(c) {
 			case 'a':
 				ind.ssb_adaptation_ind = atoi(optarg);
 				break;
-#ifdef SCTP_AUTH_CHUNK
-			case 'A':
-				if (number_of_chunks_to_auth < 256) {
-					chunk[number_of_chunks_to_auth++] = (unsigned char)atoi(optarg);
+#ifdef SCTP_AUTH_CHUNK
+			case 'A':
+				if (parse_auth(optarg) < 0) {
+					printf("Invalid authentication option\n");
+					print_usage();
+					exit(1);
+				}
+				break;
+#endif
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP)
+			case 'c':
+			{
+				char *token;
+
+				for (token = strtok(optarg, ","); token != NULL; token = strtok(NULL, ",")) {
+					if (nr_cpus < MAX_CPUS) {
+						cpus[nr_cpus++] = atoi(token);
+					}
+				}
+				break;
+			}
+#endif
+#if defined(HAVE_SENDMMSG)
+			case 'b':
+				batch_size = atoi(optarg);
+				if (batch_size == 0) {
+					printf("Batch size must be positive\n");
+					exit(1);
 				}
 				break;
 #endif
+			case 'B':
+				recv_buffer_size = atoi(optarg);
+				break;
+			case 'C':
+				setup_benchmark = 1;
+				setup_count = strtoul(optarg, NULL, 10);
+				break;
 			case 'd':
-				round_duration = atoi(optarg);
+			{
+				char *end;
+
+				round_duration = (unsigned int)strtoul(optarg, &end, 10);
+				if (*end == ',') {
+					top_associations = (unsigned int)strtoul(end + 1, &end, 10);
+				}
+				if (*end != '\0') {
+					printf("Status interval must be given as seconds[,associations]\n");
+					exit(1);
+				}
 				break;
+			}
 			case 'D':
 				nodelay = 1;
 				break;
+#if defined(SCTP_SNDINFO) && !defined(USRSCTP)
+			case 'e':
+				engine = atoi(optarg);
+#if defined(HAVE_SENDMMSG)
+				if (engine < 0 || engine > 2) {
+#else
+				if (engine < 0 || engine > 1) {
+#endif
+					printf("Unknown engine\n");
+					exit(1);
+				}
+				break;
+#endif
+			case 'E':
+				one_way_latency = 1;
+				break;
 			case 'f':
 				fragpoint = atoi(optarg);
 				break;
+			case 'F':
+				duplex = 1;
+				break;
+			case 'g':
+				bit_rate = parse_rate(optarg);
+				break;
+			case 'G':
+				message_rate = parse_rate(optarg);
+				break;
+			case 'h':
+			{
+				char *end;
+
+				coalesce_bytes = (unsigned int)strtoul(optarg, &end, 10);
+				if (*end == ',') {
+					coalesce_usecs = (unsigned int)strtoul(end + 1, &end, 10);
+				}
+				if (*end != '\0') {
+					printf("Invalid coalescing limit\n");
+					print_usage();
+					exit(1);
+				}
+				break;
+			}
+			case 'H':
+				setup_benchmark = 1;
+				hold_target = strtoul(optarg, NULL, 10);
+				break;
 #if defined(SCTP_INTERLEAVING_SUPPORTED)
 			case 'I':
 				interleave = 1;
 				break;
 #endif
+			case 'k':
+				burst = atoi(optarg);
+				if (burst == 0) {
+					printf("Burst size must be positive\n");
+					exit(1);
+				}
+				break;
+			case 'i':
+				verify = 1;
+				break;
+			case 'j':
+				nr_stream_weights = parse_list(optarg, &stream_weights);
+				break;
+			case 'J':
+				if (parse_size_distribution(optarg) < 0) {
+					printf("Invalid size distribution\n");
+					print_usage();
+					exit(1);
+				}
+				break;
+			case 'K':
+				keep_associations = 1;
+				keep_open = 1;
+				break;
 			case 'l':
-				length = atoi(optarg);
+			{
+				unsigned long long size, piece;
+				char *end;
+
+				/* The length may be left out on the server. */
+				end = optarg;
+				size = (*optarg == ':') ? (unsigned long long)length : parse_size(optarg, &end);
+				piece = 1;
+				if (*end == ':') {
+					piece = parse_size(end + 1, &end);
+					piece_size = (unsigned int)piece;
+				}
+				if (*end != '\0' || size == 0 || size > INT_MAX || piece == 0 || piece > INT_MAX) {
+					printf("Invalid length\n");
+					print_usage();
+					exit(1);
+				}
+				length = (int)size;
 				break;
+			}
 			case 'L':
 				if (nr_local_addr < MAX_LOCAL_ADDR) {
 					struct sockaddr_in *s4 = (struct sockaddr_in*) local_addr_ptr;
@@ -322,14 +6323,57 @@ int main(int argc, char **argv)
 							nr_local_addr++;
 						} else {
 							printf("Invalid address\n");
-							fprintf(stderr, "%s", Usage);
+							print_usage();
 							exit(1);
 						}
 					}
 				}
 				break;
+			case 'm':
+				one_to_many = 1;
+				break;
+#if defined(USRSCTP)
+			case 'M':
+				if (strcmp(optarg, "memory") == 0) {
+					loopback = LOOPBACK_MEMORY;
+				} else if (strcmp(optarg, "udp") == 0) {
+					loopback = LOOPBACK_UDP;
+				} else {
+					printf("Unknown loopback conduit %s\n", optarg);
+					exit(1);
+				}
+				break;
+#endif
 			case 'n':
 				number_of_messages = atoi(optarg);
+				messages_given = 1;
+				break;
+			case 'N':
+				number_of_associations = atoi(optarg);
+				if (number_of_associations == 0) {
+					printf("Number of associations must be positive\n");
+					exit(1);
+				}
+				break;
+			case 'o':
+				outstanding = atoi(optarg);
+				if (outstanding == 0) {
+					printf("Number of outstanding requests must be positive\n");
+					exit(1);
+				}
+				break;
+			case 'O':
+				if (strcmp(optarg, "text") == 0) {
+					output_format = OUTPUT_TEXT;
+				} else if (strcmp(optarg, "csv") == 0) {
+					output_format = OUTPUT_CSV;
+				} else if (strcmp(optarg, "json") == 0) {
+					output_format = OUTPUT_JSON;
+				} else {
+					printf("Unknown output format\n");
+					print_usage();
+					exit(1);
+				}
 				break;
 			case 'p':
 				port = atoi(optarg);
@@ -337,6 +6381,15 @@ int main(int argc, char **argv)
 			case 'P':
 				policy = atoi(optarg);
 				break;
+			case 'q':
+				backlog = atoi(optarg);
+				break;
+			case 'Q':
+				cpu_cost = 1;
+				break;
+			case 'r':
+				response_length = atoi(optarg);
+				break;
 			case 'R':
 				rcvbufsize = atoi(optarg);
 				break;
@@ -368,6 +6421,55 @@ int main(int argc, char **argv)
 				verbose = 1;
 				very_verbose = 1;
 				break;
+			case 'x':
+				sample_transport_stats = 1;
+				if (strcmp(optarg, "-") != 0) {
+					if ((transport_file = fopen(optarg, "w")) == NULL) {
+						perror("fopen");
+						exit(1);
+					}
+					print_transport_csv_header(transport_file);
+				}
+				break;
+			case 'W':
+				if (parse_sweep(optarg) < 0) {
+					printf("Invalid sweep\n");
+					print_usage();
+					exit(1);
+				}
+				sweeping = 1;
+				break;
+			case 'X':
+				no_ancillary = 1;
+				break;
+#if defined(SCTP_STREAM_SCHEDULER)
+			case 'y':
+				if (parse_stream_scheduler(optarg) < 0) {
+					printf("Unknown stream scheduler\n");
+					print_usage();
+					exit(1);
+				}
+				break;
+#endif
+			case 'Y':
+				warmup = atoi(optarg);
+				break;
+			case 'z':
+				per_stream = 1;
+				break;
+			case 'Z':
+				if (open_trace(optarg) < 0) {
+					exit(1);
+				}
+				break;
+#if defined(HAVE_SYS_EPOLL_H)
+			case 'w':
+				number_of_workers = atoi(optarg);
+				if (number_of_workers <= 0) {
+					number_of_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+				}
+				break;
+#endif
 			case '4':
 				ipv4only = 1;
 				if (ipv6only) {
@@ -383,10 +6485,23 @@ int main(int argc, char **argv)
 				}
 				break;
 			default:
-				fprintf(stderr, "%s", Usage);
+				print_usage();
 				exit(1);
 		}
 
+#if defined(USRSCTP)
+	if (loopback != LOOPBACK_NONE) {
+		if (optind != argc || one_to_many || duplex || (loopback == LOOPBACK_MEMORY && nr_local_addr > 0)) {
+			printf("Loopback mode takes no remote addresses and is not supported with one-to-many style sockets or duplex mode,\n"
+			       "the memory conduit takes no local addresses\n");
+			exit(1);
+		}
+		/* The server runs in a thread of this process and is bound to the local addresses. */
+		client      = 1;
+		local_port  = port;
+		remote_port = port;
+	} else
+#endif
 	if (optind == argc) {
 		client      = 0;
 		local_port  = port;
@@ -399,6 +6514,11 @@ int main(int argc, char **argv)
 
 	if (nr_local_addr == 0) {
 		memset((void *) local_addr, 0, sizeof(local_addr));
+#if defined(USRSCTP)
+		if (loopback == LOOPBACK_MEMORY) {
+			loopback_address((union sock_union *)local_addr, local_port, 1);
+		} else
+#endif
 		if (ipv4only) {
 			struct sockaddr_in *s4 = (struct sockaddr_in*) local_addr;
 			s4->sin_family      = AF_INET;
@@ -439,285 +6559,264 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if ((fd = socket((ipv4only ? AF_INET : AF_INET6), SOCK_STREAM, IPPROTO_SCTP)) < 0)
-		perror("socket");
+	send_flags = 0;
+	if (unordered) {
+		send_flags |= SCTP_UNORDERED;
+	}
+	pr_policy = 0;
+	if (pr_policy_value(policy) < 0) {
+		printf("Unknown PR-SCTP policy.\n");
+		policy = 0;
+	} else {
+		set_pr_policy(pr_policy_value(policy));
+	}
+	for (i = 0; i < sweep[SWEEP_POLICY].nr_values; i++) {
+		if (pr_policy_value(sweep[SWEEP_POLICY].values[i]) < 0) {
+			printf("Unknown PR-SCTP policy %ld.\n", sweep[SWEEP_POLICY].values[i]);
+			exit(1);
+		}
+	}
 
-	if (!ipv4only) {
-		if (ipv6only) {
-			if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, (const void*)&on, (socklen_t)sizeof(on)) < 0)
-				perror("ipv6only");
-		} else {
-			if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, (const void*)&off, (socklen_t)sizeof(off)) < 0)
-				perror("ipv6only");
+	if (output_format == OUTPUT_CSV && (!sweeping || round_duration > 0)) {
+		print_csv_header();
+		if (sample_transport_stats && transport_file == NULL) {
+			print_transport_csv_header(stdout);
 		}
 	}
+	if (sample_transport_stats && round_duration == 0) {
+		round_duration = 1;
+	}
 
-#ifdef SCTP_AUTH_CHUNK
-	for (chunk_number = 0; chunk_number < number_of_chunks_to_auth; chunk_number++) {
-		sac.sauth_chunk = chunk[chunk_number];
-		if (setsockopt(fd, IPPROTO_SCTP, SCTP_AUTH_CHUNK, &sac, (socklen_t)sizeof(struct sctp_authchunk)) < 0)
-			perror("setsockopt");
+	if (one_to_many && response_length > 0) {
+		printf("Request/response mode is not supported with one-to-many style sockets\n");
+		exit(1);
 	}
+	/* Responses, per-stream statistics and one-to-many sockets need the stream and association of each message. */
+	want_rcvinfo = very_verbose || response_length > 0 || one_to_many || per_stream || !no_ancillary;
+	if (duplex) {
+		if (one_to_many || response_length > 0 || sweeping) {
+			printf("Duplex mode is not supported with one-to-many style sockets, request/response mode or sweeps\n");
+			exit(1);
+		}
+#if defined(HAVE_SYS_EPOLL_H)
+		if (number_of_workers > 0) {
+			printf("Duplex mode is not supported with receive workers\n");
+			exit(1);
+		}
 #endif
-	if (ind.ssb_adaptation_ind > 0) {
-		if (setsockopt(fd, IPPROTO_SCTP, SCTP_ADAPTATION_LAYER, (const void*)&ind, (socklen_t)sizeof(struct sctp_setadaptation)) < 0) {
-			perror("setsockopt");
+		/* The peer ends the association while the server may still be sending. */
+		signal(SIGPIPE, SIG_IGN);
+		if (!client && !messages_given) {
+			number_of_messages = 0;
 		}
 	}
-	init.sinit_num_ostreams = streams;
-	init.sinit_max_instreams = 0xffff;
-	init.sinit_max_attempts = 0;
-	init.sinit_max_init_timeo = 0;
-	if (setsockopt(fd, IPPROTO_SCTP, SCTP_INITMSG, (const void *)&init, (socklen_t)sizeof(struct sctp_initmsg)) < 0) {
-		perror("setsockopt");
+	if (setup_benchmark) {
+		if (one_to_many || response_length > 0 || duplex || sweeping) {
+			printf("The setup benchmark is not supported with one-to-many style sockets, request/response mode,\n"
+			       "duplex mode or sweeps\n");
+			exit(1);
+		}
+		if (!messages_given) {
+			number_of_messages = 0;
+		}
 	}
-	if (!client) {
-		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const void*)&on, (socklen_t)sizeof(on));
+	stamp_messages = verify || one_way_latency;
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+	if (cpu_cost) {
+		syscall_tracepoint = find_syscall_tracepoint();
 	}
-#ifdef SCTP_REMOTE_UDP_ENCAPS_PORT
-	memset(&encaps, 0, sizeof(struct sctp_udpencaps));
-	encaps.sue_address.ss_family = (ipv4only ? AF_INET : AF_INET6);
-	encaps.sue_port = htons(udp_port);
-	if (setsockopt(fd, IPPROTO_SCTP, SCTP_REMOTE_UDP_ENCAPS_PORT, (const void*)&encaps, (socklen_t)sizeof(struct sctp_udpencaps)) < 0) {
-		perror("setsockopt");
+#endif
+	if (stamp_messages && response_length > 0) {
+		printf("Payload verification and one-way latency are not supported in request/response mode\n");
+		exit(1);
+	}
+	if (verify && client && one_to_many && number_of_associations > 1) {
+		printf("Payload verification needs a single thread with one-to-many style sockets\n");
+		exit(1);
+	}
+	if (coalesce_bytes > 0 || sweep[SWEEP_COALESCE].nr_values > 0) {
+		if (one_to_many || response_length > 0 || engine != 0) {
+			printf("Coalescing is not supported with one-to-many style sockets, request/response mode or -e\n");
+			exit(1);
+		}
+	}
+#ifdef SCTP_AUTH_CHUNK
+	if ((hmac_ident != 0 || auth_key_length > 0) && number_of_chunks_to_auth == 0) {
+		/* DATA chunks are what authentication costs most for. */
+		chunk[number_of_chunks_to_auth++] = 0;
+	}
+	if (auth_rotate > 0 && (auth_key_length == 0 || !client)) {
+		printf("Key rotation needs a key and is done by the client\n");
+		exit(1);
 	}
 #endif
-#if defined(SCTP_INTERLEAVING_SUPPORTED)
-	if (interleave != 0) {
-		int level;
-
-		level = 2;
-		if (setsockopt(fd, IPPROTO_SCTP, SCTP_FRAGMENT_INTERLEAVE, (const void*)&level, (socklen_t)sizeof(int)) < 0) {
-			perror("setsockopt");
+	if (piece_size > 0 && client) {
+#if defined(SCTP_EXPLICIT_EOR)
+		if (one_to_many || response_length > 0 || duplex || engine != 0 || coalesce_bytes > 0 ||
+		    sweep[SWEEP_COALESCE].nr_values > 0) {
+			printf("Sending messages in pieces is not supported with one-to-many style sockets, request/response mode,\n"
+			       "duplex mode, -e or coalescing\n");
+			exit(1);
 		}
-		av.assoc_id = 0;
-		av.assoc_value = 1;
-		if (setsockopt(fd, IPPROTO_SCTP, SCTP_INTERLEAVING_SUPPORTED, (const void*)&av, (socklen_t)sizeof(struct sctp_assoc_value)) < 0) {
-			perror("setsockopt");
+		if (stamp_messages && piece_size < PAYLOAD_HEADER_SIZE) {
+			printf("Stamped messages need pieces of at least %d bytes\n", PAYLOAD_HEADER_SIZE);
+			exit(1);
 		}
-	}
+#else
+		printf("Sending messages in pieces needs SCTP_EXPLICIT_EOR\n");
+		exit(1);
 #endif
-	if (nr_local_addr > 0) {
-		if (sctp_bindx(fd, (struct sockaddr *)local_addr, nr_local_addr, SCTP_BINDX_ADD_ADDR) != 0)
-			perror("bind");
 	}
-
-	if (!client) {
-		struct sctp_event_subscribe event;
-
-		if (listen(fd, 100) < 0)
-			perror("listen");
-		if (rcvbufsize)
-			if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbufsize, sizeof(int)) < 0)
-				perror("setsockopt: rcvbuf");
-		if (verbose) {
-			intlen = sizeof(int);
-			if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &myrcvbufsize, (socklen_t *)&intlen) < 0) {
-				perror("setsockopt: rcvbuf");
-			} else {
-				fprintf(stdout,"Receive buffer size: %d.\n", myrcvbufsize);
+	if (size_distribution != SIZE_FIXED) {
+		if (response_length > 0 || sweep[SWEEP_LENGTH].nr_values > 0) {
+			printf("Message size distributions and traces are not supported in request/response mode\n"
+			       "or when sweeping the length\n");
+			exit(1);
+		}
+		if (size_distribution == SIZE_TRACE) {
+			if (message_rate > 0.0 || bit_rate > 0.0 || engine == 2) {
+				printf("Traces are sent at their own pace and not supported with -g, -G or sendmmsg()\n");
+				exit(1);
+			}
+			/* Unless -n, -T or the mode asks for another number, the trace is sent once. */
+			if (!messages_given && number_of_messages > 0) {
+				number_of_messages = trace_records;
 			}
 		}
-		memset(&event, 0, sizeof(event));
-		event.sctp_data_io_event = 1;
-		if (setsockopt(fd, IPPROTO_SCTP, SCTP_EVENTS, &event, sizeof(event)) != 0) {
-			perror("set event failed");
+		/* The send buffer holds the largest message. */
+		length = (int)size_max;
+		if (stamp_messages && length < PAYLOAD_HEADER_SIZE) {
+			length = PAYLOAD_HEADER_SIZE;
 		}
+	}
 
-		while (1) {
-			memset(&remote_addr, 0, sizeof(remote_addr));
-
-			if (ipv4only) {
-				addr_len = sizeof(struct sockaddr_in);
-			} else {
-				addr_len = sizeof(struct sockaddr_in6);
-			}
+#if defined(USRSCTP)
+	if (loopback == LOOPBACK_UDP && udp_port == 0) {
+		udp_port = 9899;
+	}
+	usrsctp_init(udp_port, conduit_output, NULL);
+	if (loopback == LOOPBACK_MEMORY) {
+		start_conduits();
+	}
+#endif
+	if (!client) {
+		fd = open_listener();
+		if (round_duration > 0) {
+			pthread_t reporter_tid;
 
-			cfdptr = malloc(sizeof(int));
-			if ((*cfdptr = accept(fd, (struct sockaddr *)&remote_addr, &addr_len)) < 0) {
-				perror("accept");
-				continue;
+			if (posix_memalign((void **)&slots, CACHE_LINE_SIZE, MAX_CONNECTION_SLOTS * sizeof(union connection_slot)) != 0) {
+				printf("Can't allocate the association counters\n");
+				exit(1);
 			}
-			if (verbose) {
-				char temp[INET6_ADDRSTRLEN];
-
-				if (remote_addr.sa.sa_family == AF_INET) {
-					fprintf(stdout,"Connection accepted from %s:%d\n", inet_ntop(AF_INET, &remote_addr.s4.sin_addr, temp, INET_ADDRSTRLEN), ntohs(remote_addr.s4.sin_port));
-				} else {
-					fprintf(stdout,"Connection accepted from %s:%d\n", inet_ntop(AF_INET6, &remote_addr.s6.sin6_addr, temp, INET6_ADDRSTRLEN), ntohs(remote_addr.s6.sin6_port));
-				}
+			memset(slots, 0, MAX_CONNECTION_SLOTS * sizeof(union connection_slot));
+			if (pthread_create(&reporter_tid, NULL, &report_aggregate, NULL) != 0) {
+				perror("pthread_create");
+				exit(1);
 			}
-			pthread_create(&tid, NULL, &handle_connection, (void *) cfdptr);
 		}
-		close(fd);
+		serve(fd, cpus, nr_cpus, number_of_workers);
 	} else {
-		uint32_t flags;
-		uint32_t ppid;
+		for (nr_remote_addr = 0; optind < argc && nr_remote_addr < MAX_REMOTE_ADDR; optind++, nr_remote_addr++) {
+			union sock_union *addr = &remote_addrs[nr_remote_addr];
 
-		if (inet_pton(AF_INET6, argv[optind], &remote_addr.s6.sin6_addr)) {
-			remote_addr.s6.sin6_family = AF_INET6;
+			if (inet_pton(AF_INET6, argv[optind], &addr->s6.sin6_addr)) {
+				addr->s6.sin6_family = AF_INET6;
 #ifdef HAVE_SIN_LEN
-			remote_addr.s6.sin6_len = sizeof(struct sockaddr_in6);
+				addr->s6.sin6_len = sizeof(struct sockaddr_in6);
 #endif
-			remote_addr.s6.sin6_port = htons(remote_port);
-			addr_len = sizeof(struct sockaddr_in6);
+				addr->s6.sin6_port = htons(remote_port);
+				remote_addr_lens[nr_remote_addr] = sizeof(struct sockaddr_in6);
 
-			if (ipv4only) {
-				printf("Can't use IPv6 address when IPv4 only\n");
-				exit(1);
-			}
-		} else {
-			if (inet_pton(AF_INET, argv[optind], &remote_addr.s4.sin_addr))
-			{
-				remote_addr.s4.sin_family = AF_INET;
+				if (ipv4only) {
+					printf("Can't use IPv6 address when IPv4 only\n");
+					exit(1);
+				}
+			} else {
+				if (inet_pton(AF_INET, argv[optind], &addr->s4.sin_addr))
+				{
+					addr->s4.sin_family = AF_INET;
 #ifdef HAVE_SIN_LEN
-				remote_addr.s4.sin_len = sizeof(struct sockaddr_in);
+					addr->s4.sin_len = sizeof(struct sockaddr_in);
 #endif
-				remote_addr.s4.sin_port = htons(remote_port);
-				addr_len = sizeof(struct sockaddr_in);
+					addr->s4.sin_port = htons(remote_port);
+					remote_addr_lens[nr_remote_addr] = sizeof(struct sockaddr_in);
 
-				if (ipv6only) {
-					printf("Can't use IPv4 address when IPv6 only\n");
+					if (ipv6only) {
+						printf("Can't use IPv4 address when IPv6 only\n");
+						exit(1);
+					}
+				} else {
+					printf("Invalid address\n");
+					print_usage();
 					exit(1);
 				}
-			} else {
-				printf("Invalid address\n");
-				fprintf(stderr, "%s", Usage);
-				exit(1);
 			}
 		}
-
-		if (fragpoint) {
-			av.assoc_id = 0;
-			av.assoc_value = fragpoint;
-			if (setsockopt(fd, IPPROTO_SCTP, SCTP_MAXSEG, &av, sizeof(av)) < 0) {
-				perror("setsockopt: SCTP_MAXSEG");
+#if defined(USRSCTP)
+		if (loopback != LOOPBACK_NONE) {
+			remote_addr_lens[0] = loopback_address(&remote_addrs[0], remote_port, 0);
+			nr_remote_addr = 1;
+			fd = open_listener();
+			if (pthread_create(&tid, NULL, &loopback_server, (void *)&fd) != 0) {
+				perror("pthread_create");
+				exit(1);
 			}
 		}
+#endif
 
-		if (connect(fd, (struct sockaddr *)&remote_addr, addr_len) < 0) {
-			perror("connect");
-		}
-
-#ifdef SCTP_NODELAY
-		/* Explicit settings, because LKSCTP does not enable it by default */
-		if (nodelay == 1) {
-			if (setsockopt(fd, IPPROTO_SCTP, SCTP_NODELAY, (char *)&on, sizeof(on)) < 0) {
-				perror("setsockopt: nodelay");
-			}
-		} else {
-			if (setsockopt(fd, IPPROTO_SCTP, SCTP_NODELAY, (char *)&off, sizeof(off)) < 0) {
-				perror("setsockopt: nodelay");
-			}
+		senders = calloc(number_of_associations, sizeof(struct sender_info));
+		for (i = 0; i < number_of_associations; i++) {
+			senders[i].fd = -1;
 		}
-#endif
-		if (sndbufsize)
-			if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbufsize, sizeof(int)) < 0) {
-				perror("setsockopt: sndbuf");
+		if (setup_benchmark) {
+			if (stamp_messages && number_of_messages > 0 && length < PAYLOAD_HEADER_SIZE) {
+				printf("Stamped messages need to be at least %d bytes long\n", PAYLOAD_HEADER_SIZE);
+				exit(1);
 			}
-
-		if (verbose) {
-			intlen = sizeof(int);
-			if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &mysndbufsize, (socklen_t *)&intlen) < 0) {
-				perror("setsockopt: sndbuf");
-			} else {
-				fprintf(stdout,"Send buffer size: %d.\n", mysndbufsize);
+			run_setup(senders, number_of_associations, runtime, cpus, nr_cpus);
+		} else if (sweeping) {
+			/* Parameters not swept keep the value given on the command line. */
+			sweep_default(&sweep[SWEEP_NODELAY], nodelay);
+			sweep_default(&sweep[SWEEP_SNDBUF], sndbufsize);
+			sweep_default(&sweep[SWEEP_STREAMS], streams);
+			sweep_default(&sweep[SWEEP_LENGTH], length);
+			sweep_default(&sweep[SWEEP_POLICY], policy);
+			sweep_default(&sweep[SWEEP_PRVALUE], timetolive);
+			sweep_default(&sweep[SWEEP_COALESCE], coalesce_bytes);
+			for (i = 0; i < sweep[SWEEP_LENGTH].nr_values; i++) {
+				if (stamp_messages && sweep[SWEEP_LENGTH].values[i] < PAYLOAD_HEADER_SIZE) {
+					printf("Stamped messages need to be at least %d bytes long\n", PAYLOAD_HEADER_SIZE);
+					exit(1);
+				}
 			}
-		}
-		buffer = malloc(length);
-		memset(buffer, 'A', length);
-
-		gettimeofday(&start_time, NULL);
-		if (verbose && !very_verbose) {
-			printf("Start sending %ld messages...", (long)number_of_messages);
-			fflush(stdout);
-		}
-
-		i = 0;
-		done = 0;
-
-		if (runtime > 0) {
-			signal(SIGALRM, stop_sender);
-			alarm(runtime);
-		}
-		if (very_verbose) {
-			ppid = 0;
+			run_sweep(senders, number_of_associations, runtime, warmup, cpus, nr_cpus, bit_rate);
 		} else {
-			ppid = 39;
-		}
-		sid = 0;
-		flags = 0;
-		if (unordered) {
-			flags |= SCTP_UNORDERED;
-		}
-		switch (policy) {
-		case 0:
-#ifdef SCTP_PR_SCTP_NONE
-			flags |= SCTP_PR_SCTP_NONE;
-#endif
-			break;
-		case 1:
-#ifdef SCTP_PR_SCTP_TTL
-			flags |= SCTP_PR_SCTP_TTL;
-#endif
-			break;
-#ifdef SCTP_PR_SCTP_RTX
-		case 2:
-			flags |= SCTP_PR_SCTP_RTX;
-			break;
-#endif
-#ifdef SCTP_PR_SCTP_BUF
-		case 3:
-			flags |= SCTP_PR_SCTP_BUF;
-			break;
-
-#endif
-		default:
-			printf("Unknown PR-SCTP policy.\n");
-			break;
-		}
-		while (!done && ((number_of_messages == 0) || (i < (number_of_messages - 1)))) {
-			if (very_verbose) {
-				printf("Sending message number %lu.\n", i);
+			if (stamp_messages && length < PAYLOAD_HEADER_SIZE) {
+				printf("Stamped messages need to be at least %d bytes long\n", PAYLOAD_HEADER_SIZE);
+				exit(1);
 			}
-			if (sctp_sendmsg(fd, buffer, length, NULL, 0, htonl(ppid), flags, sid, timetolive, 0) < 0) {
-				perror("sctp_sendmsg");
-				break;
+			if (one_to_many) {
+				open_one_to_many();
 			}
-			if (very_verbose) {
-				ppid += 1;
+			if (bit_rate > 0.0) {
+				message_rate = bit_rate / (8.0 * mean_length());
 			}
-			if (++sid == streams) {
-				sid = 0;
+			run_senders(senders, number_of_associations, runtime, warmup, cpus, nr_cpus, &total);
+			if (number_of_associations > 1) {
+				for (i = 0; i < number_of_associations; i++) {
+					snprintf(prefix, sizeof(prefix), "%s %lu: ", one_to_many ? "Thread" : "Association", i);
+					print_sender_result(prefix, (long long)i, &senders[i]);
+				}
 			}
-			i++;
+			close_associations(senders, number_of_associations);
+			print_sender_result("", -1, &total);
 		}
-		if (very_verbose) {
-			printf("Sending message number %lu.\n", i);
+		free(senders);
+#if defined(USRSCTP)
+		if (loopback != LOOPBACK_NONE) {
+			loopback_wait();
 		}
-#if !defined(LINUX)
-		flags |= SCTP_EOF;
 #endif
-		if (sctp_sendmsg(fd, buffer, length, NULL, 0, htonl(ppid), flags, sid, timetolive, 0) < 0) {
-			perror("sctp_sendmsg");
-		}
-		i++;
-		if (verbose && !very_verbose)
-			printf("done.\n");
-		linger.l_onoff = 1;
-		linger.l_linger = LINGERTIME;
-		if (setsockopt(fd, SOL_SOCKET, SO_LINGER,(char*)&linger, sizeof(struct linger)) < 0) {
-			perror("setsockopt");
-		}
-		close(fd);
-		free(buffer);
-		gettimeofday(&now, NULL);
-		timersub(&now, &start_time, &diff_time);
-		seconds = diff_time.tv_sec + (double)diff_time.tv_usec/1000000;
-		fprintf(stdout, "%s of %ld messages of length %u took %f seconds.\n",
-		       "Sending", i, length, seconds);
-		throughput = (double)i * (double)length / seconds;
-		fprintf(stdout, "Throughput was %f Byte/sec.\n", throughput);
 	}
 	return 0;
 }